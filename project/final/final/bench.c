@@ -0,0 +1,123 @@
+/*
+ * bench.c
+ *
+ * This module is responsible for the benchmark of the number
+ * formatting and of the LCD (see bench.h).
+ */
+
+#include "common.h"
+#include <stdio.h>
+#include <avr/sleep.h>
+
+#ifdef BENCH
+
+/// numbers to convert: shortest, typical CLI value, longest
+static const uint16_t values[] PROGMEM = { 0, 7, 1023, 9999, 65535 };
+
+/// input of the conversions, volatile: no constant folding
+static volatile uint16_t input;
+
+/// the former int_to_str(): five divisions by 10
+static void __attribute__((noinline)) ref_int_to_str(uint16_t val, char * target)
+{
+	for (int8_t i=4;i>=0;i--)
+	{
+		target[i]= val%10 + '0';
+		val/=10;
+	}
+	target[5]=0;
+}
+
+/// start Timer1 at F_CPU (prescaler 1)
+static void timer_start()
+{
+	TCCR1A = 0;
+	TCCR1B = (1 << CS10);
+	TCNT1 = 0;
+}
+
+/// cycles of stmt, without the measurement overhead (interrupts off)
+#define CYCLES(stmt) ({ \
+	uint16_t t; \
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) \
+	{ \
+		TCNT1 = 0; \
+		stmt; \
+		t = TCNT1; \
+	} \
+	t - overhead; \
+})
+
+/// send " label=cycles"
+static void field(const char * label, uint16_t cycles)
+{
+	char num[FMT_DEC_LEN + 1];
+
+	uart_sendstring_P(PSTR(" "));
+	uart_sendstring_P(label);
+	uart_sendstring_P(PSTR("="));
+	fmt_dec(num, cycles);
+	uart_sendstring(num);
+	uart_flush();
+}
+
+/// time until the LCD shows the flushed content in us (Timer1 at F_CPU / 8)
+static uint16_t lcd_time()
+{
+	TCCR1B = (1 << CS11);
+	TCNT1 = 0;
+	lcdFlush();
+	while(lcdBusy());
+	return TCNT1 / (F_CPU / 8000000UL);
+}
+
+/// full redraw (all cells change) and a single character
+static void bench_lcd()
+{
+	uint16_t us;
+
+	lcdSpiInit();
+	lcdInit();
+
+	uart_sendstring_P(PSTR("\r\nBENCH lcd"));
+	lcdWriteString_P(0, TWO_LINES_ON, PSTR("ABCDEFGHIJKLMNOPQRSTUVWXYZ012345"));
+	us = lcd_time();
+	field(PSTR("full_us"), us);
+	field(PSTR("chars_per_s"), 32UL * 1000000UL / us);
+
+	lcdSetCursor(0, 0);
+	lcdWriteChar('*');
+	field(PSTR("char_us"), lcd_time());
+	field(PSTR("spi_div"), LCD_SPI_DIV);
+}
+
+void bench_run()
+{
+	char buf[8];
+	uint16_t overhead = 0;
+
+	timer_start();
+	overhead = CYCLES();
+
+	for(uint8_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+	{
+		input = pgm_read_word(&values[i]);
+
+		uart_sendstring_P(PSTR("\r\nBENCH "));
+		fmt_dec(buf, input);
+		uart_sendstring(buf);
+		field(PSTR("int_to_str"), CYCLES(ref_int_to_str(input, buf)));
+		field(PSTR("snprintf"), CYCLES(snprintf_P(buf, sizeof(buf), PSTR("%05u"), input)));
+		field(PSTR("fmt_dec_width"), CYCLES(fmt_dec_width(buf, input, FMT_DEC_LEN, '0')));
+		field(PSTR("fmt_dec"), CYCLES(fmt_dec(buf, input)));
+		field(PSTR("fmt_hex"), CYCLES(fmt_hex(buf, input, 4)));
+	}
+	bench_lcd();
+	uart_sendstring_P(PSTR("\r\n"));
+
+	uart_flush();
+	cli();
+	sleep_mode();
+}
+
+#endif
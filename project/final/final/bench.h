@@ -0,0 +1,33 @@
+/*
+ * bench.h
+ *
+ * This module is responsible for the benchmark of the number
+ * formatting (fmt.h) and of the LCD (dogm_lcd.h).
+ *
+ * Only compiled with -DBENCH (make bench), it runs instead of the normal
+ * firmware, e.g. in simavr. The reference implementations (the former
+ * int_to_str() and snprintf()) are only linked into this build.
+ */
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+/** @brief Run the benchmark
+ *
+ * Measures the CPU cycles (Timer1 at F_CPU) of the old and new
+ * conversions for a few numbers and sends one line per number via UART:
+ *
+ *   BENCH 65535 int_to_str=... snprintf=... fmt_dec_width=... fmt_dec=... fmt_hex=...
+ *
+ * and the time until the LCD shows a full redraw (32 changed cells)
+ * and a single changed character, with the timing selected by LCD_FAST:
+ *
+ *   BENCH lcd full_us=... chars_per_s=... char_us=... spi_div=...
+ *
+ * (in simavr the result depends on its model of the SPI transfer time)
+ *
+ * afterwards the CPU is stopped (simavr exits).
+ */
+void bench_run();
+
+#endif /* _BENCH_H_ */
@@ -0,0 +1,210 @@
+/*
+ * cli.c
+ *
+ * This module is responsible for the serial command interface (see cli.h).
+ */
+
+#include "common.h"
+
+/// max length of a command name incl. \0
+#define CLI_NAME_LEN 6
+
+static char rec_name[MAX_NAME_LEN];	//name of the command being recorded, "": none
+
+/// command table entry (in flash)
+typedef struct
+{
+	char name[CLI_NAME_LEN];
+	void (*run)(char *arg);
+} cli_cmd_t;
+
+//replies are no diagnostic output: wait for space instead of dropping them
+static void reply(const char *s)
+{
+	uart_write(s, strlen(s));
+}
+
+static void reply_P(const char *s)
+{
+	uart_write_P(s);
+}
+
+//label in flash
+static void reply_num(const char *label, uint16_t val)
+{
+	char num[FMT_DEC_LEN + 1];
+
+	fmt_dec_width(num, val, FMT_DEC_LEN, '0');
+	reply_P(label);
+	reply(num);
+}
+
+static void cmd_play(char *arg)
+{
+	ir_source_t src;
+	int8_t index = eeprom_get_command_index(arg);
+	int16_t lib;
+	uint8_t ret;
+
+	if((index >= 0) && (eeprom_open_command(index, &src) == EEPROM_OK)) {}
+	else if(((lib = irlib_get_command_index(arg)) >= 0) && (irlib_open_command(lib, &src) == IRLIB_OK)) {}
+	else
+	{
+		reply_P(PSTR("ERR not found\r\n"));
+		return;
+	}
+	ret = ir_play_source(&src);
+	if(ret == IR_PLAY_BUSY) reply_P(PSTR("ERR busy\r\n"));
+	else if(ret != IR_PLAY_OK) reply_P(PSTR("ERR empty\r\n"));
+	else reply_P(PSTR("OK\r\n"));
+}
+
+//the recording runs in the background, cli_poll() replies when it is done
+static void cmd_rec(char *arg)
+{
+	if((arg[0] == 0) || (strlen(arg) >= MAX_NAME_LEN))
+	{
+		reply_P(PSTR("ERR name\r\n"));
+		return;
+	}
+	if(ir_record_start(ir_timings) != 0)
+	{
+		reply_P(PSTR("ERR busy\r\n"));
+		return;
+	}
+	strcpy(rec_name, arg);
+}
+
+//result of "rec": store the command
+static void rec_done(uint8_t ret)
+{
+	if(ret == 1) reply_P(PSTR("ERR timeout\r\n"));
+	else if(ret == 2) reply_P(PSTR("ERR too long\r\n"));
+	else if(ret != 0) reply_P(PSTR("ERR record\r\n"));
+	else
+	{
+		ret = eeprom_store_command(-1, rec_name, ir_timings);
+		if(ret == EEPROM_ERR_FULL) reply_P(PSTR("ERR full\r\n"));
+		else if(ret != EEPROM_OK) reply_P(PSTR("ERR store\r\n"));
+		else
+		{
+			reply_num(PSTR("OK "), eeprom_get_command_index(rec_name));
+			reply_P(PSTR("\r\n"));
+		}
+	}
+	rec_name[0] = 0;
+}
+
+static void cmd_ls(char *arg)
+{
+	char name[MAX_NAME_LEN];
+	uint8_t count = eeprom_get_command_count();
+
+	for(uint8_t i = 0; i < count; i++)
+	{
+		if(eeprom_get_command_name(i, name) == 0) continue;
+		reply_num(PSTR(""), i);
+		reply_P(PSTR(" "));
+		reply(name);
+		reply_P(PSTR("\r\n"));
+	}
+	reply_num(PSTR("OK "), count);
+	reply_P(PSTR("\r\n"));
+}
+
+static void cmd_rm(char *arg)
+{
+	int8_t index = eeprom_get_command_index(arg);
+
+	if((index < 0) || (eeprom_delete_command(index) != EEPROM_OK)) reply_P(PSTR("ERR not found\r\n"));
+	else reply_P(PSTR("OK\r\n"));
+}
+
+static void cmd_stats(char *arg)
+{
+	reply_num(PSTR("commands="), eeprom_get_command_count());
+	reply_num(PSTR(" library="), irlib_get_command_count());
+	reply_num(PSTR(" storage="), STORAGE_SIZE);
+	reply_num(PSTR(" txdrop="), uart_get_overflows());
+	reply_num(PSTR(" rxdrop="), uart_get_rx_dropped());
+	reply_P(PSTR("\r\nOK\r\n"));
+}
+
+static void cmd_dump(char *arg)
+{
+	uint16_t len = 0;
+
+	//a recording overwrites the timings
+	if(ir_recording())
+	{
+		reply_P(PSTR("ERR busy\r\n"));
+		return;
+	}
+	while((len < MAX_IR_EDGES) && (ir_timings[len] != 1)) len++;
+	if((len < 2) || (len >= MAX_IR_EDGES))
+	{
+		reply_P(PSTR("ERR no capture\r\n"));
+		return;
+	}
+	//sent in the background by the dump task (see main.c)
+	reply_P(PSTR("OK\r\n"));
+	ir_dump_start(ir_timings);
+}
+
+static void cmd_tasks(char *arg)
+{
+	sched_stats_t stats;
+
+	for(uint8_t id = 0; sched_get_stats(id, &stats); id++)
+	{
+		reply_P(stats.name);
+		reply_num(PSTR(" runs="), stats.runs);
+		reply_num(PSTR(" ms="), stats.ms);
+		reply_num(PSTR(" max="), stats.max);
+		reply_P(PSTR("\r\n"));
+	}
+	reply_num(PSTR("idle ms="), sched_get_idle());
+	reply_P(PSTR("\r\nOK\r\n"));
+}
+
+static const cli_cmd_t commands[] PROGMEM =
+{
+	{ "play", cmd_play },
+	{ "rec", cmd_rec },
+	{ "ls", cmd_ls },
+	{ "rm", cmd_rm },
+	{ "stats", cmd_stats },
+	{ "dump", cmd_dump },
+	{ "tasks", cmd_tasks },
+};
+
+void cli_poll()
+{
+	char line[UART_LINE_LEN];
+	char *arg;
+	uint8_t ret;
+
+	//the next line is read when a running "rec" is done
+	if(rec_name[0])
+	{
+		ret = ir_record_poll();
+		if(ret != IR_RECORD_BUSY) rec_done(ret);
+		return;
+	}
+	if(uart_getline(line) == 0) return;
+
+	//"<command> <argument>", the argument may contain spaces
+	arg = strchr(line, ' ');
+	if(arg) *arg++ = 0;
+	else arg = &line[strlen(line)];
+
+	for(uint8_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+	{
+		if(strcmp_P(line, commands[i].name) == 0)
+		{
+			((void (*)(char *))pgm_read_word(&commands[i].run))(arg);
+			return;
+		}
+	}
+	reply_P(PSTR("ERR unknown command\r\n"));
+}
@@ -0,0 +1,34 @@
+/*
+ * cli.h
+ *
+ * This module is responsible for the serial command interface.
+ *
+ * A host (e.g. home automation) controls the device with text lines
+ * on the UART (see uart_getline()), one command per line:
+ *
+ *   play <name>    replay a stored command, or a built-in one ("lgtv.power")
+ *   rec <name>     record a command and store it under the name (the
+ *                  reply follows the capture, up to 10 s later)
+ *   ls             list the stored commands ("<index> <name>" lines)
+ *   rm <name>      delete a stored command
+ *   stats          memory and UART counters
+ *   dump           hex dump of the last capture (see ir_dump_start()),
+ *                  the dump lines follow the reply
+ *   tasks          run time of the tasks since the last "tasks" (see sched.h)
+ *
+ * Every command is answered by a line starting with "OK" or "ERR".
+ * Other lines on the UART are diagnostic output and can be ignored.
+ */
+
+#ifndef _CLI_H_
+#define _CLI_H_
+
+/** @brief Execute a received command line (non-blocking if there is none)
+ *
+ * Called from the serial task of the main loop (see main.c). A replay
+ * blocks until it is finished, a recording runs in the background: the
+ * calls check for its result, the next line is read after the reply.
+ */
+void cli_poll();
+
+#endif /* _CLI_H_ */
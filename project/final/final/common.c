@@ -26,54 +26,406 @@
 
 
 
-/** @brief Init UART
- * 
- * @param baudrate Used baudrate
+/// transmit ring buffer, head is written by the senders, tail by the ISR
+static volatile uint8_t tx_buf[UART_TX_BUF_SIZE];
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
+static uint16_t tx_overflows = 0;
+static volatile uint8_t tx_sent = 0;	///< a character was written to UDR0 (TXC0 is meaningful)
+
+/// urgent frames, sent before the transmit buffer at the next frame boundary
+static volatile uint8_t urgent_buf[UART_URGENT_BUF_SIZE];
+static volatile uint8_t urgent_head = 0;
+static volatile uint8_t urgent_tail = 0;
+static uint8_t tx_urgent = 0;			///< an urgent frame is being sent
+static uint8_t tx_boundary = 1;			///< the last character sent was 0x00 (end of a frame)
+
+/// receive line buffer, filled by the ISR until a line is complete
+static volatile char rx_line[UART_LINE_LEN];
+static volatile uint8_t rx_len = 0;
+static volatile uint8_t rx_ready = 0;
+static volatile uint8_t rx_overlong = 0;
+static volatile uint16_t rx_dropped = 0;
+
+/// receive frame buffer (binary mode)
+static volatile uint8_t rx_frame[UART_FRAME_LEN];
+static volatile uint8_t rx_frame_len = 0;
+static volatile uint8_t rx_frame_ready = 0;
+static volatile uint8_t rx_frame_mode = 0;
+
+#define TX_USED() ((uint8_t)(tx_head - tx_tail) & (UART_TX_BUF_SIZE - 1))
+#define URGENT_USED() ((uint8_t)(urgent_head - urgent_tail) & (UART_URGENT_BUF_SIZE - 1))
+
+/** @brief Init UART (UART_BAUD, 8N1)
  */
-void uart_init(uint32_t baudrate)
+void uart_init()
 {
-	//calculate baudrate register & split it into 2x1B register
-    uint16_t ubrr = (F_CPU / 8 / baudrate) -1;
-    UBRR0H = (uint8_t) (ubrr >> 8) ;
-    UBRR0L = (uint8_t) (ubrr & 0xff);
-    UCSR0B = (1<<TXEN0) | (1<<RXEN0); //enable RX&TX
+	//baudrate register is calculated at compile time (common.h)
+    UBRR0H = (uint8_t) (UART_UBRR >> 8) ;
+    UBRR0L = (uint8_t) (UART_UBRR & 0xff);
+    UCSR0B = (1<<TXEN0) | (1<<RXEN0) | (1<<RXCIE0); //enable RX&TX, RX interrupt
     UCSR0A = (1<<U2X0);//UART double speed mode
 }
 
-/** @brief Transmit one character (blocking)
+//one slot stays free to tell a full buffer from an empty one
+uint8_t uart_tx_free()
+{
+	return UART_TX_BUF_SIZE - 1 - TX_USED();
+}
+
+static void tx_put(uint8_t c)
+{
+	tx_buf[tx_head] = c;
+	tx_head = (tx_head + 1) & (UART_TX_BUF_SIZE - 1);
+}
+
+//move the next character to the UART
+static void tx_next()
+{
+	uint8_t c;
+
+	UCSR0A |= (1<<TXC0); //clear "transmit complete"
+	tx_sent = 1;
+	//an urgent frame goes between two frames, or right away if nothing
+	//else is queued (after a 0x00, so the host resynchronizes)
+	if(!tx_urgent && (urgent_head != urgent_tail) && (tx_boundary || (tx_head == tx_tail)))
+	{
+		tx_urgent = 1;
+		if(!tx_boundary)
+		{
+			UDR0 = 0;
+			tx_boundary = 1;
+			return;
+		}
+	}
+	if(tx_urgent)
+	{
+		c = urgent_buf[urgent_tail];
+		urgent_tail = (urgent_tail + 1) & (UART_URGENT_BUF_SIZE - 1);
+		if(c == 0) tx_urgent = 0;
+	}
+	else
+	{
+		c = tx_buf[tx_tail];
+		tx_tail = (tx_tail + 1) & (UART_TX_BUF_SIZE - 1);
+	}
+	tx_boundary = (c == 0);
+	UDR0 = c;
+}
+
+static void tx_overflow(uint8_t n)
+{
+	tx_overflows = (tx_overflows + n < tx_overflows) ? 0xFFFF : tx_overflows + n;
+}
+
+/** @brief Queue one character for transmission (non-blocking)
  * @param c Character to be transmitted
- * @note Blocking function!
+ * @return UART_OK or UART_ERR_OVERFLOW if the transmit buffer is full
  */
-void uart_transmit(uint8_t c)
+uint8_t uart_transmit(uint8_t c)
 {
-	while (!( UCSR0A & (1<<UDRE0))); //wait for empty data register
-	UDR0 = c; //start TX by storing in the data register
+	if(uart_tx_free() == 0)
+	{
+		tx_overflow(1);
+		return UART_ERR_OVERFLOW;
+	}
+	tx_put(c);
+	UCSR0B |= (1<<UDRIE0); //the ISR sends it
+	return UART_OK;
 }
 
 
-/** @brief Transmit a string (blocking)
+/** @brief Queue a string for transmission (non-blocking)
+ * 
+ * The string is queued completely or not at all (no torn lines).
+ * 
  * @param str String to be sent
- * @note Blocking function!
+ * @return UART_OK or UART_ERR_OVERFLOW if it does not fit into the transmit buffer
  */
-void uart_sendstring(char * str )
+uint8_t uart_sendstring(char * str )
 {
-	while ( * str) // send as long as not \0 terminated
+	size_t len = strlen(str);
+
+	if(len > uart_tx_free())
 	{
-		//send & increment pointer
-		uart_transmit(*str);
+		tx_overflow(len > 0xFF ? 0xFF : len);
+		return UART_ERR_OVERFLOW;
+	}
+	while ( * str) // queue as long as not \0 terminated
+	{
+		tx_put(*str);
 		str++;
 	}
+	UCSR0B |= (1<<UDRIE0);
+	return UART_OK;
 }
 
-void int_to_str(uint16_t val, char * target)   // convert integer number (0-1023, 5-digits) into ASCII string
+/** @brief Queue a string from flash for transmission (non-blocking)
+ * 
+ * Same as uart_sendstring(), for strings in flash (PSTR("...")), which
+ * do not occupy SRAM.
+ * 
+ * @param str String in flash
+ * @return UART_OK or UART_ERR_OVERFLOW if it does not fit into the transmit buffer
+ */
+uint8_t uart_sendstring_P(const char * str)
 {
+	size_t len = strlen_P(str);
+	char c;
 
-	for (int8_t i=4;i>=0;i--)
+	if(len > uart_tx_free())
 	{
-	    target[i]= val%10 + '0';   // convert einerstelle into ascii-readable character
-    	val/=10;                // shift value 1 to the right (in decimal)
+		tx_overflow(len > 0xFF ? 0xFF : len);
+		return UART_ERR_OVERFLOW;
 	}
+	while((c = pgm_read_byte(str++)) != 0) tx_put(c);
+	UCSR0B |= (1<<UDRIE0);
+	return UART_OK;
+}
 
-	target[5]=0;  // endkennung f�r string
+/** @brief Wait until all queued characters are sent
+ * @note Blocking function! Works with interrupts disabled, too.
+ */
+void uart_flush()
+{
+	while((tx_head != tx_tail) || (urgent_head != urgent_tail))
+	{
+		//no interrupts -> send from here
+		if(!(SREG & (1<<SREG_I)) && (UCSR0A & (1<<UDRE0))) tx_next();
+	}
+	//wait for the last frame to leave the shift register
+	if(tx_sent) while(!(UCSR0A & (1<<TXC0)));
 }
 
+/** @brief Number of characters dropped because the transmit buffer was full
+ * @return overflow counter (saturates at 0xFFFF)
+ */
+uint16_t uart_get_overflows()
+{
+	uint16_t n;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE){ n = tx_overflows; }
+	return n;
+}
+
+/** @brief Send a block of data which must not be dropped
+ * 
+ * Waits for room in the transmit buffer (for protocol data, diagnostic
+ * output uses the non-blocking functions).
+ * 
+ * @param data Data to be sent
+ * @param len Number of bytes
+ */
+void uart_write(const void * data, uint16_t len)
+{
+	const uint8_t *p = data;
+
+	while(len)
+	{
+		uint8_t n = uart_tx_free();
+		if(n > len) n = len;
+		len -= n;
+		while(n--) tx_put(*p++);
+		UCSR0B |= (1<<UDRIE0);
+	}
+}
+
+/** @brief Send a string from flash which must not be dropped
+ * 
+ * Same as uart_write(), for strings in flash (PSTR("...")).
+ * 
+ * @param str String in flash
+ */
+void uart_write_P(const char * str)
+{
+	char c;
+
+	while((c = pgm_read_byte(str++)) != 0)
+	{
+		while(uart_tx_free() == 0);
+		tx_put(c);
+		UCSR0B |= (1<<UDRIE0);
+	}
+}
+
+/** @brief Queue an urgent frame (non-blocking)
+ * 
+ * The frame is sent before the transmit buffer as soon as the frame in
+ * progress is complete: it waits for at most one frame (plus the rest of
+ * the transmit buffer if it holds text). Only one caller may use it, from
+ * the main loop like uart_write() (the IR event task, irdec_service()),
+ * the frame is queued completely or not at all.
+ * 
+ * @param frame Encoded frame incl. the 0x00 delimiter (see frame_pack())
+ * @param len Number of bytes
+ * @return UART_OK or UART_ERR_OVERFLOW if it does not fit into the urgent buffer
+ */
+uint8_t uart_write_urgent(const void * frame, uint8_t len)
+{
+	const uint8_t *p = frame;
+
+	if(len > UART_URGENT_BUF_SIZE - 1 - URGENT_USED()) return UART_ERR_OVERFLOW;
+	while(len--)
+	{
+		urgent_buf[urgent_head] = *p++;
+		urgent_head = (urgent_head + 1) & (UART_URGENT_BUF_SIZE - 1);
+	}
+	UCSR0B |= (1<<UDRIE0);
+	return UART_OK;
+}
+
+/** @brief Is a received line waiting? (non-blocking)
+ * @return 1 if uart_getline() will return a line, 0 otherwise
+ */
+uint8_t uart_line_ready()
+{
+	return rx_ready;
+}
+
+/** @brief Fetch the received line (non-blocking)
+ * 
+ * Further characters are only received after the line was fetched.
+ * 
+ * @param line (out) -> Destination, UART_LINE_LEN bytes
+ * @return Length of the line, 0 if there is none
+ */
+uint8_t uart_getline(char * line)
+{
+	uint8_t len;
+
+	if(!rx_ready) return 0;
+	//the ISR does not touch the buffer while rx_ready is set
+	len = rx_len;
+	memcpy(line, (const char *)rx_line, len + 1);
+	rx_len = 0;
+	rx_ready = 0;
+	return len;
+}
+
+/** @brief Is a received binary frame waiting? (non-blocking)
+ * @return 1 if uart_getframe() will return a frame, 0 otherwise
+ */
+uint8_t uart_frame_ready()
+{
+	return rx_frame_ready;
+}
+
+/** @brief Fetch the received frame (non-blocking)
+ * 
+ * @param frame (out) -> Destination, UART_FRAME_LEN bytes (encoded, without delimiter)
+ * @return Length of the frame, 0 if there is none
+ */
+uint8_t uart_getframe(uint8_t * frame)
+{
+	uint8_t len;
+
+	if(!rx_frame_ready) return 0;
+	len = rx_frame_len;
+	memcpy(frame, (const uint8_t *)rx_frame, len);
+	rx_frame_len = 0;
+	rx_frame_ready = 0;
+	return len;
+}
+
+/** @brief Switch the receiver between binary frames and text lines
+ * @param on 1: binary frames, 0: text lines
+ */
+void uart_frame_mode(uint8_t on)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		rx_frame_mode = on;
+		rx_frame_len = 0;
+		rx_frame_ready = 0;
+		rx_len = 0;
+	}
+}
+
+/** @brief Number of received characters which were dropped
+ * (line not fetched yet or line too long)
+ * @return drop counter (saturates at 0xFFFF)
+ */
+uint16_t uart_get_rx_dropped()
+{
+	uint16_t n;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE){ n = rx_dropped; }
+	return n;
+}
+
+static void rx_drop()
+{
+	if(rx_dropped != 0xFFFF) rx_dropped++;
+}
+
+//binary mode: collect the encoded frame up to the 0x00 delimiter
+static void rx_frame_byte(uint8_t c)
+{
+	if(rx_frame_ready)
+	{
+		rx_drop();
+		return;
+	}
+	if(c == 0)
+	{
+		if((rx_frame_len > 0) && (rx_frame_len <= UART_FRAME_LEN)) rx_frame_ready = 1;
+		else rx_frame_len = 0;		//empty or overlong frame
+		return;
+	}
+	if(rx_frame_len < UART_FRAME_LEN) rx_frame[rx_frame_len] = c;
+	else rx_drop();
+	if(rx_frame_len <= UART_FRAME_LEN) rx_frame_len++;
+}
+
+ISR(USART_RX_vect)
+{
+	char c = UDR0;
+
+	//0x00 never appears in text: start of the binary protocol
+	if((c == 0) && !rx_frame_mode)
+	{
+		rx_frame_mode = 1;
+		rx_frame_len = 0;
+		return;
+	}
+	if(rx_frame_mode)
+	{
+		rx_frame_byte(c);
+		return;
+	}
+
+	if(rx_ready)
+	{
+		//line not fetched yet (the LF of a CR LF is no loss)
+		if(c != '\n') rx_drop();
+		return;
+	}
+	if((c == '\r') || (c == '\n'))
+	{
+		if(rx_overlong) rx_len = 0;		//discard the whole line
+		rx_overlong = 0;
+		if(rx_len == 0) return;			//empty line (or CR LF)
+		rx_line[rx_len] = 0;
+		rx_ready = 1;
+		return;
+	}
+	if((c == '\b') || (c == 0x7F))
+	{
+		if(rx_len) rx_len--;
+		return;
+	}
+	if(rx_len < UART_LINE_LEN - 1) rx_line[rx_len++] = c;
+	else
+	{
+		rx_overlong = 1;
+		rx_drop();
+	}
+}
+
+ISR(USART_UDRE_vect)
+{
+	if((tx_head == tx_tail) && (urgent_head == urgent_tail))
+	{
+		UCSR0B &= ~(1<<UDRIE0); //empty -> stop until the next character is queued
+		return;
+	}
+	tx_next();
+}
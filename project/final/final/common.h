@@ -28,32 +28,41 @@
 #include <avr/io.h>
 #include <util/delay.h>
 #include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
 #include <string.h>
 #include "ir.h"
 #include "dogm_lcd.h"
+#include "spi.h"
+#include "twi.h"
+#include "storage.h"
 #include "eeprom.h"
+#include "irlib.h"
 #include "menu.h"
+#include "selftest.h"
+#include "bench.h"
+#include "cli.h"
+#include "frame.h"
+#include "proto.h"
+#include "xfer.h"
+#include "stream.h"
+#include "sniff.h"
+#include "irdec.h"
+#include "fmt.h"
+#include "log.h"
+#include "tick.h"
+#include "keys.h"
+#include "sched.h"
 
 
 
-/** @brief Length of IR timings array
- * @warning Size in bytes is double (we allocate this number of uint16_t)
- */
-#define MAX_IR_EDGES 250
-
-/** @brief Max length of any IR command name
- * 
- * Please take care of the length, do not accept input names longer than this array!
- */
-#define MAX_NAME_LEN 10
-
-
 /** @brief Array of timestamps between edges
  * 
  * This array is used as global "scratchpad" to store IR edges on recording
- * (because the EEPROM is too slow) or as memory for replaying a command.
- * (EEPROM is too slow on loading -> timings must be in the array before
- * replay starts).
+ * (because the EEPROM is too slow).
+ * Stored commands are not loaded into this array for replay, they are
+ * streamed from the EEPROM chunk by chunk (see ir_source_t).
  * 
  * @see MAXSIZE_IR_TIMINGS
  */
@@ -74,24 +83,171 @@ extern char ir_name[MAX_NAME_LEN];
 ////////////////////////////////////////////////////////////////////////
 
 
-/** @brief Init UART
+/** @brief UART baudrate (UART_BAUD in the Makefile), double speed mode (U2X)
+ * 
+ * The divisor is computed here, a baudrate which cannot be generated
+ * from F_CPU with an error below 2 % stops the build. Exact at 16 MHz:
+ * 250k, 500k, 1M, 2M.
+ */
+#ifndef UART_BAUD
+#define UART_BAUD 1000000UL
+#endif
+#define UART_UBRR ((F_CPU + 4UL * UART_BAUD) / (8UL * UART_BAUD) - 1)
+#define UART_BAUD_REAL (F_CPU / (8UL * (UART_UBRR + 1)))
+/// baudrate error in 0.1 %
+#define UART_BAUD_ERROR ((UART_BAUD_REAL > UART_BAUD ? UART_BAUD_REAL - UART_BAUD : UART_BAUD - UART_BAUD_REAL) * 1000UL / UART_BAUD)
+#if UART_UBRR > 4095
+#error "UART_BAUD too low for F_CPU"
+#endif
+#if UART_BAUD_ERROR > 20
+#error "UART_BAUD cannot be generated from F_CPU (error > 2 %)"
+#endif
+
+/** @brief Size of the UART transmit buffer (power of 2, max. 128)
  * 
- * @param baudrate Used baudrate
+ * Characters are queued and sent by the UDRE interrupt, the senders
+ * do not wait for the UART.
  */
-void uart_init(uint32_t baudrate);
+#ifndef UART_TX_BUF_SIZE
+#define UART_TX_BUF_SIZE 64
+#endif
 
-/** @brief Transmit one character (blocking)
+/** @brief Size of the UART urgent frame buffer (power of 2, max. 128)
+ * 
+ * Holds frames which must not wait behind the transmit buffer
+ * (see uart_write_urgent()).
+ */
+#define UART_URGENT_BUF_SIZE 32
+
+/** @brief Size of the UART receive line buffer (incl. \0)
+ * 
+ * The receive interrupt collects one line (terminated by CR or LF),
+ * longer lines are discarded.
+ */
+#define UART_LINE_LEN 32
+
+/** @brief Size of the UART receive frame buffer (one encoded frame, see frame.h)
+ * 
+ * A 0x00 byte switches the receiver to binary frames (proto.c), every
+ * frame ends with 0x00. uart_frame_mode(0) switches back to text lines.
+ */
+#define UART_FRAME_LEN FRAME_MAX_ENCODED
+
+/** @brief Return codes of the UART send functions */
+#define UART_OK 0
+#define UART_ERR_OVERFLOW 1		///< not enough space in the transmit buffer, nothing queued
+
+/** @brief Init UART (UART_BAUD, 8N1)
+ */
+void uart_init();
+
+/** @brief Queue one character for transmission (non-blocking)
  * @param c Character to be transmitted
- * @note Blocking function!
+ * @return UART_OK or UART_ERR_OVERFLOW if the transmit buffer is full
  */
-void uart_transmit(uint8_t c);
+uint8_t uart_transmit(uint8_t c);
 
-/** @brief Transmit a string (blocking)
+/** @brief Queue a string for transmission (non-blocking)
+ * 
+ * The string is queued completely or not at all (no torn lines).
+ * 
  * @param str String to be sent
- * @note Blocking function!
+ * @return UART_OK or UART_ERR_OVERFLOW if it does not fit into the transmit buffer
+ */
+uint8_t uart_sendstring(char * str );
+
+/** @brief Queue a string from flash for transmission (non-blocking)
+ * 
+ * Same as uart_sendstring(), for strings in flash (PSTR("...")), which
+ * do not occupy SRAM.
+ * 
+ * @param str String in flash
+ * @return UART_OK or UART_ERR_OVERFLOW if it does not fit into the transmit buffer
+ */
+uint8_t uart_sendstring_P(const char * str);
+
+/** @brief Free space in the transmit buffer
+ * @return Number of characters which can be queued without overflow
+ */
+uint8_t uart_tx_free();
+
+/** @brief Wait until all queued characters are sent
+ * @note Blocking function! Works with interrupts disabled, too.
+ */
+void uart_flush();
+
+/** @brief Number of characters dropped because the transmit buffer was full
+ * @return overflow counter (saturates at 0xFFFF)
+ */
+uint16_t uart_get_overflows();
+
+/** @brief Send a block of data which must not be dropped
+ * 
+ * Waits for room in the transmit buffer (for protocol data, diagnostic
+ * output uses the non-blocking functions).
+ * 
+ * @param data Data to be sent
+ * @param len Number of bytes
+ */
+void uart_write(const void * data, uint16_t len);
+
+/** @brief Send a string from flash which must not be dropped
+ * 
+ * Same as uart_write(), for strings in flash (PSTR("...")).
+ * 
+ * @param str String in flash
+ */
+void uart_write_P(const char * str);
+
+/** @brief Queue an urgent frame (non-blocking)
+ * 
+ * The frame is sent before the transmit buffer as soon as the frame in
+ * progress is complete: it waits for at most one frame (plus the rest of
+ * the transmit buffer if it holds text). Only one caller may use it, from
+ * the main loop like uart_write() (the IR event task, irdec_service()),
+ * the frame is queued completely or not at all.
+ * 
+ * @param frame Encoded frame incl. the 0x00 delimiter (see frame_pack())
+ * @param len Number of bytes
+ * @return UART_OK or UART_ERR_OVERFLOW if it does not fit into the urgent buffer
  */
-void uart_sendstring(char * str );
+uint8_t uart_write_urgent(const void * frame, uint8_t len);
 
-void int_to_str(uint16_t val, char * target);
+/** @brief Is a received line waiting? (non-blocking)
+ * @return 1 if uart_getline() will return a line, 0 otherwise
+ */
+uint8_t uart_line_ready();
+
+/** @brief Fetch the received line (non-blocking)
+ * 
+ * Further characters are only received after the line was fetched.
+ * 
+ * @param line (out) -> Destination, UART_LINE_LEN bytes
+ * @return Length of the line, 0 if there is none
+ */
+uint8_t uart_getline(char * line);
+
+/** @brief Is a received binary frame waiting? (non-blocking)
+ * @return 1 if uart_getframe() will return a frame, 0 otherwise
+ */
+uint8_t uart_frame_ready();
+
+/** @brief Fetch the received frame (non-blocking)
+ * 
+ * @param frame (out) -> Destination, UART_FRAME_LEN bytes (encoded, without delimiter)
+ * @return Length of the frame, 0 if there is none
+ */
+uint8_t uart_getframe(uint8_t * frame);
+
+/** @brief Switch the receiver between binary frames and text lines
+ * @param on 1: binary frames, 0: text lines
+ */
+void uart_frame_mode(uint8_t on);
+
+/** @brief Number of received characters which were dropped
+ * (line/frame not fetched yet or too long)
+ * @return drop counter (saturates at 0xFFFF)
+ */
+uint16_t uart_get_rx_dropped();
 
 #endif /* _COMMON_H_ */
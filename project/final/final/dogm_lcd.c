@@ -9,6 +9,17 @@
 			  must be initialized in master mode with a speed of (fosc /32).The
 			  functions are segmented in control functions and write functions.
 
+			  The write functions (lcdClear, lcdSetCursor, lcdWriteChar,
+			  lcdWriteString) only change a shadow of the display in SRAM,
+			  lcdFlush sends the cells which differ from the display content,
+			  so redrawing an unchanged screen costs no SPI transfer.
+
+			  The bytes are not sent by the caller: they are queued with the
+			  RS level and the settle time of the display and sent from the
+			  interrupts (SPI_STC_vect: byte sent, Timer2 compare B: settle
+			  time over, see tick.h), a write returns at once. Only lcdInit
+			  writes blocking.
+
   \attention  The information contained herein is confidential property of the
               Institute of Embedded Systems - Technikum Wien. The use, copying,
               transfer or disclosure of such information is prohibited except 
@@ -25,8 +36,12 @@
 #endif
 
 #include "dogm_lcd.h"
-#include <stdarg.h>
-#include <stdio.h>
+#include "spi.h"
+#include "tick.h"
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <string.h>
 
 // Ports for the display (Arduino I/O Board FH-TW::Embsys)
 #define PORT_DIRECTION DDRB
@@ -49,9 +64,160 @@
 #define SS_UNSELECT PORT_VALUE |= (1 << SS);
 #define SS_SELECT PORT_VALUE &= ~(1 << SS);
 
+// Size of the shadow buffer (row 0, row 1)
+#define LCD_CELLS ((MAX_ROW + 1) * (MAX_COL + 1))
+
+// DDRAM address of the first cell of row 1
+#define LINE2_ADDR 0x40
+
+// Send queue: byte and control (RS, settle time in Timer2 ticks)
+#define LCD_QUEUE_SIZE 64
+#define LCD_QUEUE_DATA 0x80
+#define LCD_QUEUE_TICKS 0x7F
+
+// Timer2 (free running, see tick.h) compare B for the settle times
+#define LCD_TICK_US TICK_TIMER_US
+// duration of a byte on the bus
+#define LCD_TRANSFER_NS (8 * LCD_SPI_DIV * (1000000000UL / F_CPU))
+// time from the start of a byte to the start of the next one
+// (data write or short instruction), at least the transfer plus the
+// time to run the SPI interrupt
+#if LCD_FAST
+#define LCD_PERIOD_NS ((ST7036_EXEC_NS > LCD_TRANSFER_NS + 2000) ? ST7036_EXEC_NS : LCD_TRANSFER_NS + 2000)
+#else
+#define LCD_PERIOD_NS (LCD_TRANSFER_NS + 20000)
+#endif
+#define LCD_SETTLE_TICKS ((LCD_PERIOD_NS + LCD_TICK_US * 1000 - 1) / (LCD_TICK_US * 1000))
+#if LCD_SETTLE_TICKS > LCD_QUEUE_TICKS
+#error "LCD byte period does not fit into the queue entry"
+#endif
+// retry when the bus is used by the flash
+#define LCD_RETRY_TICKS (20 / LCD_TICK_US)
+// shortest one shot: the counter may advance while OCR2B is set
+#define LCD_MIN_TICKS 2
+
 // Internal functions to write a byte to the display
 void writeCommand(uint8_t cmd);
 
+static volatile uint8_t queue_byte[LCD_QUEUE_SIZE];
+static volatile uint8_t queue_ctrl[LCD_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0;	// written by the UI
+static volatile uint8_t queue_tail = 0;	// written by the interrupts
+// transfer or settle time in progress (the interrupts drain the queue)
+static volatile uint8_t queue_busy = 0;
+
+// requested content (written by the UI) and content of the display
+static char frame[LCD_CELLS];
+static char shown[LCD_CELLS];
+// cursor in the frame (cell index, LCD_CELLS: behind the last cell)
+static uint8_t cursor = 0;
+// DDRAM address counter of the display (auto increment)
+static uint8_t ddram = 0;
+
+// one shot of Timer2 compare B after ticks (interrupts off)
+static void timerStart(uint8_t ticks)
+{
+	OCR2B = TCNT2 + ticks;
+	TIFR2 = (1 << OCF2B);
+	TIMSK2 |= (1 << OCIE2B);
+}
+
+// send the next queued byte (interrupts off)
+static void sendNext()
+{
+	uint8_t ctrl;
+
+	if(queue_tail == queue_head)
+	{
+		queue_busy = 0;
+		return;
+	}
+	queue_busy = 1;
+	if(!spi_acquire(SPI_OWNER_LCD))
+	{
+		timerStart(LCD_RETRY_TICKS);
+		return;
+	}
+	ctrl = queue_ctrl[queue_tail];
+	if(ctrl & LCD_QUEUE_DATA)
+		RS_DATA
+	else
+		RS_INSTRUCTION
+	SS_SELECT
+	// only for this byte: the flash polls SPIF itself
+	SPCR |= (1 << SPIE);
+	SPDR = queue_byte[queue_tail];
+	// the period runs from the start of this byte
+	timerStart(ctrl & LCD_QUEUE_TICKS);
+	queue_tail = (queue_tail + 1) & (LCD_QUEUE_SIZE - 1);
+}
+
+// byte sent: release the bus (the timer runs on)
+ISR(SPI_STC_vect)
+{
+	SPCR &= ~(1 << SPIE);
+	SS_UNSELECT
+	spi_release(SPI_OWNER_LCD);
+}
+
+// period over (or bus free again): next byte
+ISR(TIMER2_COMPB_vect)
+{
+	TIMSK2 &= ~(1 << OCIE2B);
+	// SPI interrupt still pending (higher priority of Timer2)
+	if(SPCR & (1 << SPIE))
+	{
+		timerStart(LCD_MIN_TICKS);
+		return;
+	}
+	sendNext();
+}
+
+// free entries in the queue
+static uint8_t queueFree()
+{
+	return (queue_tail - queue_head - 1) & (LCD_QUEUE_SIZE - 1);
+}
+
+// queue a byte, the caller checked queueFree()
+static void queuePut(uint8_t byte, uint8_t ctrl)
+{
+	queue_byte[queue_head] = byte;
+	queue_ctrl[queue_head] = ctrl;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		queue_head = (queue_head + 1) & (LCD_QUEUE_SIZE - 1);
+		if(!queue_busy)
+			sendNext();
+	}
+}
+
+// queue an instruction, waits while the queue is full
+static void queueInstruction(uint8_t cmd)
+{
+	while(queueFree() == 0);
+	queuePut(cmd, LCD_SETTLE_TICKS);
+}
+
+// set the DDRAM address of the display, if it is not already there
+// returns 0 if the queue is full
+static uint8_t setAddress(uint8_t addr)
+{
+	if(addr == ddram)
+		return 1;
+	if(queueFree() == 0)
+		return 0;
+	queuePut(0x80|addr, LCD_SETTLE_TICKS);
+	ddram = addr;
+	return 1;
+}
+
+// DDRAM address of a cell
+static uint8_t cellAddress(uint8_t cell)
+{
+	return (cell > MAX_COL) ? LINE2_ADDR + cell - (MAX_COL + 1) : cell;
+}
+
 
 /*********************************************************************/
  /**
@@ -67,16 +233,12 @@ void writeCommand(uint8_t cmd);
  */
 void lcdSpiInit()
 {
-	DDRB |= (1 << DDB3) | (1 << DDB5) | (1 << DDB2); // MOSI, SS, SCK output
-	DDRB &= ~(1 << DDB4); // MISO input
-
-	//init SPI
-	// SPI2X...Double SPI Speed Bit
-	// SPE...SPI Enable Bit
-	// MSTR...Master SPI Mode
-	// SPR1...SCK Frequency set to Fosc/32
-	SPSR |= (1<<SPI2X);  
-	SPCR |= ((1<<SPE) | (1<<MSTR) | (1<<SPR1) | (1<<CPOL) | (1<<CPHA));
+	//init SPI (shared with the external flash, see spi.c)
+	// the LCD clock (F_CPU / LCD_SPI_DIV, see dogm_lcd.h) is set on every
+	// spi_acquire(SPI_OWNER_LCD)
+	spi_init();
+	// Timer2 for the settle times of the send queue
+	tick_init();
 }
 
 /*********************************************************************/
@@ -137,6 +299,12 @@ void lcdInit()
 	writeCommand(0x06);
 	_delay_us(20);
 
+	// the display is empty, cursor at home
+	memset(frame, ' ', LCD_CELLS);
+	memset(shown, ' ', LCD_CELLS);
+	cursor = 0;
+	ddram = 0;
+
 	SS_UNSELECT
 }
 
@@ -156,26 +324,19 @@ void lcdInit()
  */
 void lcdOnOff(uint8_t mode)
 {
-	RS_INSTRUCTION
-	
 	if(mode == LCD_ON)
-	{
-		writeCommand(0x0F);
-		_delay_us(20);
-	}
+		queueInstruction(0x0F);
 	else if (mode == LCD_OFF)
-	{
-		writeCommand(0x08);
-		_delay_us(20);
-	}
+		queueInstruction(0x08);
 }
 
 /*********************************************************************/
  /**
  * \brief  Function to clear the display
  *
- *         This function clears the display and switches on the 
- *         cursor.
+ *         This function clears the display (shadow) and sets the
+ *         cursor to the home position. Nothing is sent, the cells
+ *         which are not overwritten are cleared by lcdFlush.
  *
  * \param       No input parameter
  * \return		No return value
@@ -183,18 +344,17 @@ void lcdOnOff(uint8_t mode)
  */
 void lcdClear()
 {
-	RS_INSTRUCTION
-	writeCommand(0x01);
-	_delay_ms(1);
+	memset(frame, ' ', LCD_CELLS);
+	cursor = 0;
 }
 
 /*********************************************************************/
  /**
  * \brief  Function to write a charakter to the display
  *
- *         This function writes a single character to the display.
- *         Beside the write command it also sets the RS pin for
- *         the transfer of a databyte.
+ *         This function writes a single character to the display
+ *         (shadow) at the cursor position and moves the cursor to
+ *         the next cell (the end of row 0 continues in row 1).
  *
  * \param       character x
  * \return		No return value
@@ -202,64 +362,76 @@ void lcdClear()
  */
 void lcdWriteChar(char x)
 {	
-	RS_DATA
-	writeCommand(x);
-	_delay_us(20);
+	if(cursor < LCD_CELLS)
+		frame[cursor++] = x;
 }
 
-/*********************************************************************/
- /**
- * \brief  Function to write a string to the display
- *
- *         This function writes a string to the display. It uses
- *         the lcdWriteChar function to write the single character.
- *         It is possible to choose if both or only one row of
- *         the Display is used
- *
- * \param       row (starting row), twoLines ()
- * \return		returns the number of written characters or -1 if
- *				string was too long
- *
- */
-int  lcdWriteString(uint8_t row,uint8_t twoLines, const char * format, ...)
+//write the text (in flash or SRAM) and pad the line(s) with spaces
+static int lcdWriteText(uint8_t row, uint8_t twoLines, const char * text, uint8_t flash)
 {
-	char text[33];
-	uint8_t pos = 0;
-	uint8_t length = 0;
-	uint8_t maxLength = 17;
-	va_list args;
+	uint8_t maxLength = MAX_COL + 1;
+	char c = 1;
 
 	// set the cursor and the rigth length
 	if(twoLines == TWO_LINES_ON)
 	{
-		maxLength = 33;
+		maxLength = LCD_CELLS;
 		lcdSetCursor(0, 0);
 	}
 	else	
 		lcdSetCursor(row, 0);	
 
-	// Generate the string for the display
-	va_start( args, format );
-    length = vsnprintf(text, maxLength, format, args );
-	va_end( args );
-
-	while(pos < maxLength)
+	for(uint8_t pos = 0; pos < maxLength; pos++)
 	{
-		if (pos == 16 && twoLines == TWO_LINES_ON)
-			lcdSetCursor(1, 0);
-		if(pos >= length && length != -1)
-			lcdWriteChar(' ');
-		else	
-			lcdWriteChar(text[pos]);
-		pos++;
+		if(c != 0)
+			c = flash ? pgm_read_byte(&text[pos]) : text[pos];
+		lcdWriteChar((c != 0) ? c : ' ');
 	}
-	
-	if(length == -1)
+
+	// the rest did not fit
+	if(c != 0 && (flash ? pgm_read_byte(&text[maxLength]) : text[maxLength]) != 0)
 		return ERROR;
 	
 	return OK;
 }
 
+/*********************************************************************/
+ /**
+ * \brief  Function to write a string to the display
+ *
+ *         This function writes a string to the display. It uses
+ *         the lcdWriteChar function to write the single character.
+ *         It is possible to choose if both or only one row of
+ *         the Display is used, the rest of the row(s) is cleared.
+ *         Numbers are formatted with the fmt_* functions (fmt.h).
+ *
+ * \param       row (starting row), twoLines (), text
+ * \return		returns OK or ERROR if the string was too long
+ *				(the part that fits is written)
+ *
+ */
+int  lcdWriteString(uint8_t row,uint8_t twoLines, const char * text)
+{
+	return lcdWriteText(row, twoLines, text, 0);
+}
+
+/*********************************************************************/
+ /**
+ * \brief  Function to write a string from flash to the display
+ *
+ *         Same as lcdWriteString, but the string is in flash
+ *         (PSTR("...")) and does not occupy SRAM.
+ *
+ * \param       row (starting row), twoLines (), text
+ * \return		returns OK or ERROR if the string was too long
+ *				(the part that fits is written)
+ *
+ */
+int  lcdWriteString_P(uint8_t row,uint8_t twoLines, const char * text)
+{
+	return lcdWriteText(row, twoLines, text, 1);
+}
+
 /*********************************************************************/
  /**
  * \brief  Function to set the cursor to a specific position
@@ -267,7 +439,8 @@ int  lcdWriteString(uint8_t row,uint8_t twoLines, const char * format, ...)
  *         This function sets the cursor to a specific position. The
  *         position is represented by the row and the column. If the 
  *         user input crosses the maximum values the position is set
- *         to the maximum values.
+ *         to the maximum values. The display cursor is moved by
+ *         lcdFlush.
  *
  * \param       row and col (column)
  * \return		No return value
@@ -275,20 +448,12 @@ int  lcdWriteString(uint8_t row,uint8_t twoLines, const char * format, ...)
  */
 void lcdSetCursor(uint8_t row, uint8_t col)
 {
-	RS_INSTRUCTION
 	if(row > MAX_ROW)
 		row = MAX_ROW;
 	if(col > MAX_COL)
 		col = MAX_COL;
 
-	if(row == LINE2)
-		row = 0x40;
-
-	row += col;
-
-	// Set DDRAM Address
-	writeCommand(0x80|row);
-	_delay_us(20);
+	cursor = row * (MAX_COL + 1) + col;
 }
 
 /*********************************************************************/
@@ -306,8 +471,6 @@ void lcdSetCursor(uint8_t row, uint8_t col)
  */
 void lcdCursorOnOff(uint8_t cursorOnOff, uint8_t positionOnOff)
 {
-	RS_INSTRUCTION
-
 	if(cursorOnOff == CURSOR_ON)
 		cursorOnOff = 0x02;
 	else	
@@ -318,8 +481,55 @@ void lcdCursorOnOff(uint8_t cursorOnOff, uint8_t positionOnOff)
 	else	
 		cursorOnOff &= 0xFE;
 		
-	writeCommand(0x0C|cursorOnOff);
-	_delay_us(20);
+	queueInstruction(0x0C|cursorOnOff);
+}
+
+/*********************************************************************/
+ /**
+ * \brief  Function to update the display from the shadow
+ *
+ *         This function sends the cells which differ from the display
+ *         content. Consecutive cells are sent with one address command
+ *         (auto increment), the address is only set again after a gap.
+ *         Afterwards the display cursor is moved to the cursor position
+ *         if it is somewhere else. An unchanged shadow costs only the
+ *         compare, nothing is sent.
+ *
+ * \param       No input parameter
+ * \return		No return value
+ *
+ */
+void lcdFlush()
+{
+	for(uint8_t cell = 0; cell < LCD_CELLS; cell++)
+	{
+		if(frame[cell] == shown[cell])
+			continue;
+		// queue full: the rest is sent by the next flush
+		if(queueFree() < 2)
+			return;
+		setAddress(cellAddress(cell));
+		queuePut(frame[cell], LCD_QUEUE_DATA | LCD_SETTLE_TICKS);
+		shown[cell] = frame[cell];
+		ddram++;
+	}
+
+	// cursor behind the last cell: stays at the end of row 1
+	setAddress(cellAddress((cursor < LCD_CELLS) ? cursor : LCD_CELLS - 1));
+}
+
+/*********************************************************************/
+ /**
+ * \brief  Function to check if the display is still being written
+ *
+ * \param       No input parameter
+ * \return		1 while queued bytes are sent, 0 when the display
+ *				shows the last flushed content
+ *
+ */
+uint8_t lcdBusy()
+{
+	return queue_busy;
 }
 
 /*********************************************************************/
@@ -327,9 +537,12 @@ void lcdCursorOnOff(uint8_t cursorOnOff, uint8_t positionOnOff)
  * \brief  Function to send a byte to the display via SPI
  *
  *         This function send a byte via SPI to the display. Before
- *         sending the byte the slave select (SS) pin is set to zero.
+ *         sending the byte the SPI bus is acquired (shared with the
+ *         external flash) and the slave select (SS) pin is set to zero.
  *         After wrtiting the byte to the send register of the SPI
  *         the function waits that the message was send successfully.
+ *         Only used by lcdInit, afterwards the bytes are queued
+ *         (see lcdFlush).
  *
  * \param       cmd (command to be send)
  * \return		No return value
@@ -337,10 +550,11 @@ void lcdCursorOnOff(uint8_t cursorOnOff, uint8_t positionOnOff)
  */
 void writeCommand(uint8_t cmd)
 {
+	while(!spi_acquire(SPI_OWNER_LCD));
 	SS_SELECT
-	SPDR = cmd;
-	while(!(SPSR & (1 << SPIF)));
+	spi_transfer(cmd);
 	SS_UNSELECT
+	spi_release(SPI_OWNER_LCD);
 }
 
 
@@ -9,6 +9,11 @@
 			  must be initialized in master mode with a speed of (fosc /32).The
 			  functions are segmented in control functions and write functions.
 
+			  The write functions (lcdClear, lcdSetCursor, lcdWriteChar,
+			  lcdWriteString) only change a shadow of the display in SRAM,
+			  lcdFlush sends the cells which differ from the display content,
+			  so redrawing an unchanged screen costs no SPI transfer.
+
   \attention  The information contained herein is confidential property of the
               Institute of Embedded Systems - Technikum Wien. The use, copying,
               transfer or disclosure of such information is prohibited except 
@@ -77,6 +82,67 @@
 #define OK 0
 #define ERROR 1
 
+/*!
+  \def        LCD_FAST
+              Timing of the display (make LCD_FAST=1).
+              0: timing of the original driver, SPI fosc/32 and 20 us
+                 after every byte (shorter than the datasheet, but proven
+                 on the board).
+              1: fastest timing within the ST7036 datasheet: the fastest
+                 SPI clock the controller allows and the execution time
+                 of the controller between two bytes, the next byte is
+                 already transferred while the previous one executes.
+*/
+#ifndef LCD_FAST
+#define LCD_FAST 0
+#endif
+
+/*!
+  \def        ST7036_*
+              ST7036 datasheet values (VDD 5 V, fOSC 380 kHz): shortest
+              SPI clock cycle, execution time of a data write and of
+              all instructions except clear display / return home.
+*/
+#define ST7036_SCLK_MAX_HZ 5000000UL
+#define ST7036_EXEC_NS 26300UL
+
+/*!
+  \def        LCD_SPI_DIV
+              SPI clock divider of the display (F_CPU / LCD_SPI_DIV) and
+              the SPCR (SPR1:0) and SPSR (SPI2X) bits for it, set on
+              spi_acquire(SPI_OWNER_LCD).
+*/
+#if !LCD_FAST
+#define LCD_SPI_DIV 32
+#elif F_CPU / 2 <= ST7036_SCLK_MAX_HZ
+#define LCD_SPI_DIV 2
+#elif F_CPU / 4 <= ST7036_SCLK_MAX_HZ
+#define LCD_SPI_DIV 4
+#elif F_CPU / 8 <= ST7036_SCLK_MAX_HZ
+#define LCD_SPI_DIV 8
+#elif F_CPU / 16 <= ST7036_SCLK_MAX_HZ
+#define LCD_SPI_DIV 16
+#else
+#define LCD_SPI_DIV 32
+#endif
+
+#if LCD_SPI_DIV == 2
+#define LCD_SPCR_BITS 0
+#define LCD_SPSR_BITS (1 << SPI2X)
+#elif LCD_SPI_DIV == 4
+#define LCD_SPCR_BITS 0
+#define LCD_SPSR_BITS 0
+#elif LCD_SPI_DIV == 8
+#define LCD_SPCR_BITS (1 << SPR0)
+#define LCD_SPSR_BITS (1 << SPI2X)
+#elif LCD_SPI_DIV == 16
+#define LCD_SPCR_BITS (1 << SPR0)
+#define LCD_SPSR_BITS 0
+#else
+#define LCD_SPCR_BITS (1 << SPR1)
+#define LCD_SPSR_BITS (1 << SPI2X)
+#endif
+
 // Functions to control the display
 void lcdSpiInit();
 void lcdInit();
@@ -87,6 +153,9 @@ void lcdCursorOnOff(uint8_t cursorOnOff, uint8_t positionOnOff);
 
 // Functions to write to the display
 void lcdWriteChar(char x);
-int  lcdWriteString(uint8_t row,uint8_t twoLines, const char * format, ...);
+int  lcdWriteString(uint8_t row,uint8_t twoLines, const char * text);
+int  lcdWriteString_P(uint8_t row,uint8_t twoLines, const char * text);
+void lcdFlush();
+uint8_t lcdBusy();
 
 #endif /*DOGM_LCD_H*/
@@ -1,13 +1,135 @@
 /*
- * eeprom.h
+ * eeprom.c
  * 
  * This module is responsible for the storage part.
  * 
- * TBD: extend this file header with infos & name
+ * See eeprom.h for the layout of the command library, the memory
+ * itself is accessed through the storage backend (storage.h).
  */
 
 #include "common.h"
 
+/// first byte after the header (first record)
+#define LIB_START EEPROM_HEADER_SIZE
+/// first byte after the library
+#define LIB_END STORAGE_SIZE
+
+/// size of a record in bytes
+#define REC_SIZE(edges) (EEPROM_REC_HEADER_SIZE + 2 * (uint16_t)(edges))
+
+/// fixed part of a record
+typedef struct
+{
+	uint8_t status;
+	uint8_t edges;
+} rec_t;
+
+
+static void mem_write_byte(uint16_t addr, uint8_t val)
+{
+	storage_write(addr, &val, 1);
+}
+
+/* Read the record at addr.
+ * Returns the address of the following record, 0 at the end of the log
+ * (or if the record does not fit into the memory -> corrupted).
+ */
+static uint16_t rec_read(uint16_t addr, rec_t *rec)
+{
+	if(addr + EEPROM_REC_HEADER_SIZE > LIB_END) return 0;
+	storage_read(addr, rec, sizeof(rec_t));
+	if(rec->status == EEPROM_REC_FREE) return 0;
+	if(addr + REC_SIZE(rec->edges) > LIB_END) return 0;
+	return addr + REC_SIZE(rec->edges);
+}
+
+/* Find the valid record with the given index.
+ * Returns the address of the record, 0 if there is none.
+ */
+static uint16_t rec_find(uint8_t index, rec_t *rec)
+{
+	uint16_t addr = LIB_START;
+	uint16_t next;
+
+	while((next = rec_read(addr, rec)) != 0)
+	{
+		if(rec->status == EEPROM_REC_VALID)
+		{
+			if(index == 0) return addr;
+			index--;
+		}
+		addr = next;
+	}
+	return 0;
+}
+
+/* Returns the address of the end of the log (first free byte). */
+static uint16_t lib_end()
+{
+	uint16_t addr = LIB_START;
+	uint16_t next;
+	rec_t rec;
+
+	while((next = rec_read(addr, &rec)) != 0) addr = next;
+	return addr;
+}
+
+/* Returns the number of bytes used by valid records. */
+static uint16_t lib_used()
+{
+	uint16_t addr = LIB_START;
+	uint16_t next;
+	uint16_t used = 0;
+	rec_t rec;
+
+	while((next = rec_read(addr, &rec)) != 0)
+	{
+		if(rec.status == EEPROM_REC_VALID) used += next - addr;
+		addr = next;
+	}
+	return used;
+}
+
+/* Move all valid records to the beginning of the library
+ * (removes the deleted records). Returns the new end of the log.
+ */
+static uint16_t lib_compact()
+{
+	uint16_t src = LIB_START;
+	uint16_t dst = LIB_START;
+	uint16_t next;
+	uint8_t buf[16];
+	rec_t rec;
+
+	while((next = rec_read(src, &rec)) != 0)
+	{
+		if(rec.status == EEPROM_REC_VALID)
+		{
+			//dst is always <= src, copying upwards is safe
+			for(uint16_t i = 0; i < next - src; i += sizeof(buf))
+			{
+				uint16_t n = next - src - i;
+				if(n > sizeof(buf)) n = sizeof(buf);
+				storage_read(src + i, buf, n);
+				storage_write(dst + i, buf, n);
+			}
+			dst += next - src;
+		}
+		src = next;
+	}
+	if(dst < LIB_END) mem_write_byte(dst, EEPROM_REC_FREE);
+	return dst;
+}
+
+/* Write an empty library. */
+static void lib_format()
+{
+	uint8_t header[EEPROM_HEADER_SIZE] = { EEPROM_MAGIC_0, EEPROM_MAGIC_1, EEPROM_VERSION, 0xFF };
+
+	storage_write(0, header, sizeof(header));
+	mem_write_byte(LIB_START, EEPROM_REC_FREE);
+	storage_flush();
+}
 
 
 /** @brief Init EEPROM
@@ -16,16 +138,23 @@
  * This function checks for a valid memory too.
  * 
  * @note EEPROM memory has an "empty" value of 0xFF!
- * @return 0 on success, error code otherwise
- * TBD: implement & document error codes
+ * @return EEPROM_OK on success, EEPROM_ERR_CORRUPT if the memory had to be
+ * formatted (no commands available), EEPROM_ERR_MEMORY if the memory
+ * does not respond
  */
 uint8_t eeprom_init()
 {
-	uart_sendstring("TBD:");
-	uart_sendstring((char *)__func__);
-	uart_sendstring("\r\n");
-	
-	return 0;
+	uint8_t header[EEPROM_HEADER_SIZE];
+
+	if(storage_init() != 0) return EEPROM_ERR_MEMORY;
+	storage_read(0, header, sizeof(header));
+	if((header[0] != EEPROM_MAGIC_0) || (header[1] != EEPROM_MAGIC_1) || (header[2] != EEPROM_VERSION))
+	{
+		lib_format();
+		return EEPROM_ERR_CORRUPT;
+	}
+
+	return EEPROM_OK;
 }
 
 
@@ -38,11 +167,18 @@ uint8_t eeprom_init()
  */
 uint8_t eeprom_get_command_count()
 {
-	uart_sendstring("TBD:");
-	uart_sendstring((char *)__func__);
-	uart_sendstring("\r\n");
-	
-	return 0;
+	uint16_t addr = LIB_START;
+	uint16_t next;
+	uint8_t count = 0;
+	rec_t rec;
+
+	while((next = rec_read(addr, &rec)) != 0)
+	{
+		if(rec.status == EEPROM_REC_VALID) count++;
+		addr = next;
+	}
+
+	return count;
 }
 
 /** @brief Get index for a name
@@ -56,10 +192,23 @@ uint8_t eeprom_get_command_count()
  */
 int8_t eeprom_get_command_index(char * name)
 {
-	uart_sendstring("TBD:");
-	uart_sendstring((char *)__func__);
-	uart_sendstring("\r\n");
-	
+	uint16_t addr = LIB_START;
+	uint16_t next;
+	int8_t index = 0;
+	char stored[MAX_NAME_LEN];
+	rec_t rec;
+
+	while((next = rec_read(addr, &rec)) != 0)
+	{
+		if(rec.status == EEPROM_REC_VALID)
+		{
+			storage_read(addr + sizeof(rec_t), stored, MAX_NAME_LEN);
+			if(strncmp(stored, name, MAX_NAME_LEN) == 0) return index;
+			index++;
+		}
+		addr = next;
+	}
+
 	return -1;
 }
 
@@ -68,17 +217,20 @@ int8_t eeprom_get_command_index(char * name)
  * This function returns the name of command (stored in the pointer name)
  * for a given index.
  * 
- * @param name (out) -> Pointer where the name is stored
+ * @param name (out) -> Pointer where the name is stored (MAX_NAME_LEN bytes)
  * @param index Index of the command, of which the name should be returned
  * @return Length of the name string, 0 when no valid command at the index.
  */
 uint8_t eeprom_get_command_name(uint8_t index, char * name)
 {
-	uart_sendstring("TBD:");
-	uart_sendstring((char *)__func__);
-	uart_sendstring("\r\n");
-	
-	return 0;
+	rec_t rec;
+	uint16_t addr = rec_find(index, &rec);
+
+	if(addr == 0) return 0;
+	storage_read(addr + sizeof(rec_t), name, MAX_NAME_LEN);
+	name[MAX_NAME_LEN - 1] = 0;
+
+	return strlen(name);
 }
 
 /** @brief Store a command on a given index
@@ -86,39 +238,144 @@ uint8_t eeprom_get_command_name(uint8_t index, char * name)
  * This function is called when a command is recorded successfully.
  * It stores an IR command (ir edges / name) to the given EEPROM address
  * (calculated with the index).
+ * If there is already a command on this index or with this name, it is
+ * replaced. A negative index (or an index past the last command) appends
+ * a new command.
  * 
- * @param ir Pointer to array of recorded edge timings
+ * @param ir Pointer to array of recorded edge timings (terminated by 1)
  * @param name Pointer to name of command
  * @param index Where to store this command
- * @return 0 when successful, error code otherwise
- * TBD: implement & document error codes
+ * @return EEPROM_OK when successful, EEPROM_ERR_FULL or EEPROM_ERR_LENGTH otherwise
  */
 uint8_t eeprom_store_command(int8_t index, char * name, uint16_t * ir)
 {
-	uart_sendstring("TBD:");
-	uart_sendstring((char *)__func__);
-	uart_sendstring("\r\n");
-	
-	return 0;
+	uint16_t edges = 0;
+	uint16_t addr;
+	uint16_t old = 0;
+	uint16_t free;
+	uint8_t count = eeprom_get_command_count();
+	char stored[MAX_NAME_LEN];
+	rec_t rec;
+
+	while((edges < MAX_IR_EDGES) && (ir[edges] != 1)) edges++;
+	if((edges == 0) || (edges >= MAX_IR_EDGES)) return EEPROM_ERR_LENGTH;
+
+	//replace an existing command: by index, otherwise by name
+	if((index < 0) || (rec_find(index, &rec) == 0)) index = eeprom_get_command_index(name);
+
+	if((index < 0) && (count >= EEPROM_MAX_COMMANDS)) return EEPROM_ERR_FULL;
+
+	free = LIB_END - LIB_START - lib_used();
+	if(index >= 0)
+	{
+		old = rec_find(index, &rec);
+		free += REC_SIZE(rec.edges);
+	}
+	if(REC_SIZE(edges) > free) return EEPROM_ERR_FULL;
+
+	//the old command is deleted after the new one is valid, a power loss
+	//in between leaves both. Only if the compaction needs its space (or
+	//both would exceed the index range) it goes first.
+	addr = lib_end();
+	if((addr + REC_SIZE(edges) > LIB_END) || (old && (count >= EEPROM_MAX_COMMANDS)))
+	{
+		if(old)
+		{
+			mem_write_byte(old, EEPROM_REC_DELETED);
+			storage_flush();
+			old = 0;
+		}
+		if(addr + REC_SIZE(edges) > LIB_END) addr = lib_compact();
+	}
+
+	memset(stored, 0, MAX_NAME_LEN);
+	strncpy(stored, name, MAX_NAME_LEN - 1);
+	rec.status = EEPROM_REC_FREE;
+	rec.edges = edges;
+	storage_write(addr, &rec, sizeof(rec_t));
+	storage_write(addr + sizeof(rec_t), stored, MAX_NAME_LEN);
+	storage_write(addr + EEPROM_REC_HEADER_SIZE, ir, 2 * edges);
+	if(addr + REC_SIZE(edges) < LIB_END) mem_write_byte(addr + REC_SIZE(edges), EEPROM_REC_FREE);
+	//mark valid as last step, an interrupted store leaves no half command
+	storage_flush();
+	mem_write_byte(addr, EEPROM_REC_VALID);
+	storage_flush();
+	if(old)
+	{
+		mem_write_byte(old, EEPROM_REC_DELETED);
+		storage_flush();
+	}
+
+	return EEPROM_OK;
 }
 
 /** @brief Load a command (only IR timings) from given Index
  * 
  * This function loads the edge timings for a given index into the given
  * pointer to the array.
- * @param ir Pointer to array where the timings will be loaded
+ * @param ir Pointer to array where the timings will be loaded (terminated by 1)
  * @param index Where to load the command from.
- * @return 0 when successful, error code otherwise
- * TBD: implement & document error codes
+ * @return EEPROM_OK when successful, EEPROM_ERR_INDEX otherwise
  */
 uint8_t eeprom_load_command(uint8_t index, uint16_t * ir)
 {
-	uart_sendstring("TBD:");
-	uart_sendstring((char *)__func__);
-	uart_sendstring("\r\n");
-	
-	return 0;
-} 
+	rec_t rec;
+	uint16_t addr = rec_find(index, &rec);
+
+	if(addr == 0) return EEPROM_ERR_INDEX;
+	storage_read(addr + EEPROM_REC_HEADER_SIZE, ir, 2 * rec.edges);
+	ir[rec.edges] = 1;
+
+	return EEPROM_OK;
+}
+
+//replay source reading directly from the EEPROM
+static uint8_t source_read(ir_source_t *src, uint16_t offset, uint16_t *buf, uint8_t count)
+{
+	if(offset >= src->len) return 0;
+	if(offset + count > src->len) count = src->len - offset;
+	storage_read(src->addr + 2 * offset, buf, 2 * count);
+	return count;
+}
+
+/** @brief Open a command for replay
+ * 
+ * Initializes a replay source which reads the timings of the command
+ * directly from the EEPROM, chunk by chunk (see ir_play_source()).
+ * 
+ * @param index Which command to open
+ * @param src (out) -> replay source
+ * @return EEPROM_OK when successful, EEPROM_ERR_INDEX otherwise
+ */
+uint8_t eeprom_open_command(uint8_t index, ir_source_t * src)
+{
+	rec_t rec;
+	uint16_t addr = rec_find(index, &rec);
+
+	if(addr == 0) return EEPROM_ERR_INDEX;
+	src->read = source_read;
+	src->data = 0;
+	src->addr = addr + EEPROM_REC_HEADER_SIZE;
+	src->len = rec.edges;
+
+	return EEPROM_OK;
+}
+
+
+/** @brief Get size of the library image
+ * 
+ * The image is the used part of the memory: header, all records
+ * (also deleted ones) and the end marker. Copying these bytes to
+ * another unit clones the library (see xfer.h).
+ * 
+ * @return Number of bytes from address 0
+ */
+uint16_t eeprom_get_image_size()
+{
+	uint16_t end = lib_end();
+
+	return (end < LIB_END) ? end + 1 : LIB_END;
+}
 
 
 /** @brief Delete IR command on given index
@@ -126,15 +383,16 @@ uint8_t eeprom_load_command(uint8_t index, uint16_t * ir)
  * This function deletes the command on the given index.
  * 
  * @param index Which command to delete
- * @return 0 when successful, error code otherwise
- * TBD: implement & document error codes
+ * @return EEPROM_OK when successful, EEPROM_ERR_INDEX otherwise
  */
 uint8_t eeprom_delete_command(uint8_t index)
 {
-	uart_sendstring("TBD:");
-	uart_sendstring((char *)__func__);
-	uart_sendstring("\r\n");
-	
-	return 0;
-}
+	rec_t rec;
+	uint16_t addr = rec_find(index, &rec);
 
+	if(addr == 0) return EEPROM_ERR_INDEX;
+	mem_write_byte(addr, EEPROM_REC_DELETED);
+	storage_flush();
+
+	return EEPROM_OK;
+}
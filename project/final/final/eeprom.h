@@ -3,20 +3,58 @@
  * 
  * This module is responsible for the storage part.
  * 
- * TBD: extend this file header with infos & name
+ * The IR commands are stored as a log of variable sized records in the
+ * memory of the storage backend (internal EEPROM by default, see storage.h):
+ * 
+ *   address 0: 'I' 'R' EEPROM_VERSION 0xFF       (header)
+ *   address 4: record, record, ..., 0xFF           (end of log)
+ * 
+ * (addresses relative to the start of the storage backend)
+ * 
+ * record:  status (1B) | edges (1B) | name (MAX_NAME_LEN B) | timings (edges * 2B, little endian)
+ * 
+ * status is EEPROM_REC_VALID for a stored command and EEPROM_REC_DELETED
+ * for a deleted one, 0xFF (erased) marks the end of the log. The timings
+ * are stored like in ir_timings (index 0 is the space before the first
+ * mark), but without the terminating 1. Deleted records are only marked,
+ * the space is reclaimed on the next store that does not fit anymore.
+ * 
+ * Command indices count the valid records only, starting with 0.
  */
 
 #ifndef _EEPROM_H_
 #define _EEPROM_H_
 
+/** @brief Error codes of the eeprom_* functions */
+#define EEPROM_OK 0
+#define EEPROM_ERR_FULL 1		///< not enough free memory for this command
+#define EEPROM_ERR_INDEX 2		///< no valid command at this index
+#define EEPROM_ERR_LENGTH 3		///< no timings or too many timings
+#define EEPROM_ERR_CORRUPT 4	///< memory was not formatted or corrupted and has been formatted
+#define EEPROM_ERR_MEMORY 5		///< the (external) memory does not respond
+
+/** @brief Layout of the command library, see file header */
+#define EEPROM_MAGIC_0 'I'
+#define EEPROM_MAGIC_1 'R'
+#define EEPROM_VERSION 1
+#define EEPROM_HEADER_SIZE 4
+#define EEPROM_REC_HEADER_SIZE (2 + MAX_NAME_LEN)
+#define EEPROM_REC_FREE 0xFF
+#define EEPROM_REC_VALID 0x5A
+#define EEPROM_REC_DELETED 0x00
+
+/** @brief Max number of commands (indices are int8_t) */
+#define EEPROM_MAX_COMMANDS 127
+
 /** @brief Init EEPROM
  * 
  * Initialize I2C interface & EEPROM.
  * This function checks for a valid memory too.
  * 
  * @note EEPROM memory has an "empty" value of 0xFF!
- * @return 0 on success, error code otherwise
- * TBD: implement & document error codes
+ * @return EEPROM_OK on success, EEPROM_ERR_CORRUPT if the memory had to be
+ * formatted (no commands available), EEPROM_ERR_MEMORY if the memory
+ * does not respond
  */
 uint8_t eeprom_init ();  
 
@@ -46,7 +84,7 @@ int8_t eeprom_get_command_index (char * name);
  * This function returns the name of command (stored in the pointer name)
  * for a given index.
  * 
- * @param name (out) -> Pointer where the name is stored
+ * @param name (out) -> Pointer where the name is stored (MAX_NAME_LEN bytes)
  * @param index Index of the command, of which the name should be returned
  * @return Length of the name string, 0 when no valid command at the index.
  */
@@ -57,12 +95,14 @@ uint8_t eeprom_get_command_name (uint8_t index, char * name);
  * This function is called when a command is recorded successfully.
  * It stores an IR command (ir edges / name) to the given EEPROM address
  * (calculated with the index).
+ * If there is already a command on this index or with this name, it is
+ * replaced. A negative index (or an index past the last command) appends
+ * a new command.
  * 
- * @param ir Pointer to array of recorded edge timings
+ * @param ir Pointer to array of recorded edge timings (terminated by 1)
  * @param name Pointer to name of command
  * @param index Where to store this command
- * @return 0 when successful, error code otherwise
- * TBD: implement & document error codes
+ * @return EEPROM_OK when successful, EEPROM_ERR_FULL or EEPROM_ERR_LENGTH otherwise
  */
 uint8_t eeprom_store_command (int8_t index, char * name, uint16_t * ir);  
 
@@ -70,21 +110,41 @@ uint8_t eeprom_store_command (int8_t index, char * name, uint16_t * ir);
  * 
  * This function loads the edge timings for a given index into the given
  * pointer to the array.
- * @param ir Pointer to array where the timings will be loaded
+ * @param ir Pointer to array where the timings will be loaded (terminated by 1)
  * @param index Where to load the command from.
- * @return 0 when successful, error code otherwise
- * TBD: implement & document error codes
+ * @return EEPROM_OK when successful, EEPROM_ERR_INDEX otherwise
  */
 uint8_t eeprom_load_command (uint8_t index, uint16_t * ir);  
 
+/** @brief Open a command for replay
+ * 
+ * Initializes a replay source which reads the timings of the command
+ * directly from the EEPROM, chunk by chunk (see ir_play_source()).
+ * 
+ * @param index Which command to open
+ * @param src (out) -> replay source
+ * @return EEPROM_OK when successful, EEPROM_ERR_INDEX otherwise
+ */
+uint8_t eeprom_open_command (uint8_t index, ir_source_t * src);
+
+
+/** @brief Get size of the library image
+ * 
+ * The image is the used part of the memory: header, all records
+ * (also deleted ones) and the end marker. Copying these bytes to
+ * another unit clones the library (see xfer.h).
+ * 
+ * @return Number of bytes from address 0
+ */
+uint16_t eeprom_get_image_size ();
+
 
 /** @brief Delete IR command on given index
  * 
  * This function deletes the command on the given index.
  * 
  * @param index Which command to delete
- * @return 0 when successful, error code otherwise
- * TBD: implement & document error codes
+ * @return EEPROM_OK when successful, EEPROM_ERR_INDEX otherwise
  */
 uint8_t eeprom_delete_command (uint8_t index);  
 
@@ -0,0 +1,86 @@
+/*
+ * fmt.c
+ *
+ * This module is responsible for formatting numbers as text (see fmt.h).
+ */
+
+#include "common.h"
+
+/// weights of the digits in front of the ones
+static const uint16_t pow10[FMT_DEC_LEN - 1] PROGMEM = { 10000, 1000, 100, 10 };
+
+/** @brief Format a number in decimal
+ *
+ * @param s (out) -> Destination, FMT_DEC_LEN + 1 bytes
+ * @param val Number
+ * @return Length of the string (1..FMT_DEC_LEN)
+ */
+uint8_t fmt_dec(char * s, uint16_t val)
+{
+	return fmt_dec_width(s, val, 0, ' ');
+}
+
+/** @brief Format a number in decimal, right aligned in a field
+ *
+ * The field is filled up in front of the number with the pad character,
+ * '0' for zero padding ("00042") or ' ' for alignment ("   42").
+ * The field is never longer than width: if the number does not fit,
+ * it is filled with '*' (a wrong number would be worse, e.g. on the LCD).
+ *
+ * @param s (out) -> Destination, width + 1 bytes
+ * @param val Number
+ * @param width Size of the field, 0: as long as needed (like fmt_dec())
+ * @param pad Pad character
+ * @return Length of the string (width)
+ */
+uint8_t fmt_dec_width(char * s, uint16_t val, uint8_t width, char pad)
+{
+	char digits[FMT_DEC_LEN];
+	uint8_t n = 0;
+
+	for(uint8_t i = 0; i < FMT_DEC_LEN - 1; i++)
+	{
+		uint16_t weight = pgm_read_word(&pow10[i]);
+		char digit = '0';
+
+		while(val >= weight)
+		{
+			val -= weight;
+			digit++;
+		}
+		//no leading zeros, the padding is added below
+		if(n || (digit != '0')) digits[n++] = digit;
+	}
+	digits[n++] = '0' + val;
+
+	if(width == 0) width = n;
+	if(n > width) memset(s, '*', width);
+	else
+	{
+		memset(s, pad, width - n);
+		memcpy(&s[width - n], digits, n);
+	}
+	s[width] = 0;
+	return width;
+}
+
+/** @brief Format a number in hex (upper case, zero padded)
+ *
+ * @param s (out) -> Destination, digits + 1 bytes
+ * @param val Number
+ * @param digits Number of digits (1..4), the lowest nibbles are written
+ * @return Length of the string (digits)
+ */
+uint8_t fmt_hex(char * s, uint16_t val, uint8_t digits)
+{
+	for(int8_t i = digits - 1; i >= 0; i--)
+	{
+		char c = '0' + (val & 0x0F);
+
+		if(c > '9') c += 'A' - '9' - 1;
+		s[i] = c;
+		val >>= 4;
+	}
+	s[digits] = 0;
+	return digits;
+}
@@ -0,0 +1,58 @@
+/*
+ * fmt.h
+ *
+ * This module is responsible for formatting numbers as text (UART and
+ * LCD output), without printf and without divisions:
+ *
+ *   decimal: digit by digit, subtracting the powers of ten (at most
+ *            32 subtractions, for 59999; 19 for 65535), the AVR has no
+ *            hardware division and every / or % is a call of the ~200
+ *            cycle library routine
+ *   hex:     nibble by nibble (shifts only)
+ *
+ * All functions write a terminated string and return its length
+ * (without the terminating 0), so several fields can be appended:
+ *
+ *   p += fmt_dec(p, count);
+ *   p += fmt_hex(p, code, 4);
+ */
+
+#ifndef _FMT_H_
+#define _FMT_H_
+
+/** @brief Max length of a 16 bit decimal number (65535) */
+#define FMT_DEC_LEN 5
+
+/** @brief Format a number in decimal
+ *
+ * @param s (out) -> Destination, FMT_DEC_LEN + 1 bytes
+ * @param val Number
+ * @return Length of the string (1..FMT_DEC_LEN)
+ */
+uint8_t fmt_dec(char * s, uint16_t val);
+
+/** @brief Format a number in decimal, right aligned in a field
+ *
+ * The field is filled up in front of the number with the pad character,
+ * '0' for zero padding ("00042") or ' ' for alignment ("   42").
+ * The field is never longer than width: if the number does not fit,
+ * it is filled with '*' (a wrong number would be worse, e.g. on the LCD).
+ *
+ * @param s (out) -> Destination, width + 1 bytes
+ * @param val Number
+ * @param width Size of the field, 0: as long as needed (like fmt_dec())
+ * @param pad Pad character
+ * @return Length of the string (width)
+ */
+uint8_t fmt_dec_width(char * s, uint16_t val, uint8_t width, char pad);
+
+/** @brief Format a number in hex (upper case, zero padded)
+ *
+ * @param s (out) -> Destination, digits + 1 bytes
+ * @param val Number
+ * @param digits Number of digits (1..4), the lowest nibbles are written
+ * @return Length of the string (digits)
+ */
+uint8_t fmt_hex(char * s, uint16_t val, uint8_t digits);
+
+#endif /* _FMT_H_ */
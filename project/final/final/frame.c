@@ -0,0 +1,107 @@
+/*
+ * frame.c
+ *
+ * This module is responsible for the binary frame format (see frame.h).
+ */
+
+#ifdef __AVR__
+#include "common.h"
+#include <util/crc16.h>
+#else
+#include <stdint.h>
+#include <string.h>
+#include "frame.h"
+
+//same as avr-libc's _crc_xmodem_update()
+static uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+	crc ^= (uint16_t)data << 8;
+	for(uint8_t i = 0; i < 8; i++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+	return crc;
+}
+#endif
+
+uint16_t frame_crc16(uint16_t crc, const uint8_t *data, uint16_t len)
+{
+	while(len--) crc = _crc_xmodem_update(crc, *data++);
+	return crc;
+}
+
+uint16_t cobs_encode(const uint8_t *src, uint16_t len, uint8_t *dst)
+{
+	uint16_t code_pos = 0;	//where the length code of the current block goes
+	uint16_t out = 1;
+	uint8_t code = 1;
+
+	while(len--)
+	{
+		if(*src)
+		{
+			dst[out++] = *src;
+			code++;
+		}
+		if((*src == 0) || (code == 0xFF))
+		{
+			dst[code_pos] = code;
+			code_pos = out++;
+			code = 1;
+		}
+		src++;
+	}
+	dst[code_pos] = code;
+	return out;
+}
+
+int16_t cobs_decode(const uint8_t *src, uint16_t len, uint8_t *dst)
+{
+	uint16_t in = 0;
+	uint16_t out = 0;
+
+	while(in < len)
+	{
+		uint8_t code = src[in++];
+
+		if((code == 0) || (in + code - 1 > len)) return -1;
+		for(uint8_t i = 1; i < code; i++)
+		{
+			if(src[in] == 0) return -1;
+			dst[out++] = src[in++];
+		}
+		//a block shorter than 254 bytes stands for a 0 (except at the end)
+		if((code != 0xFF) && (in < len)) dst[out++] = 0;
+	}
+	return out;
+}
+
+uint8_t frame_pack(uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t len, uint8_t *out)
+{
+	uint8_t raw[FRAME_MAX_DECODED];
+	uint16_t crc;
+	uint8_t n;
+
+	if(len > FRAME_MAX_PAYLOAD) len = FRAME_MAX_PAYLOAD;
+	raw[0] = type;
+	raw[1] = seq;
+	if(len) memcpy(&raw[2], payload, len);
+	crc = frame_crc16(0, raw, len + 2);
+	raw[len + 2] = crc & 0xFF;
+	raw[len + 3] = crc >> 8;
+	n = cobs_encode(raw, len + FRAME_OVERHEAD, out);
+	out[n++] = 0;
+	return n;
+}
+
+int16_t frame_unpack(uint8_t *buf, uint16_t len)
+{
+	int16_t n;
+	uint16_t crc;
+
+	if((len == 0) || (len > FRAME_MAX_ENCODED)) return FRAME_ERR_SIZE;
+	//the decoded data is never longer than the encoded data -> in place
+	n = cobs_decode(buf, len, buf);
+	if(n < 0) return FRAME_ERR_COBS;
+	if(n < FRAME_OVERHEAD) return FRAME_ERR_SIZE;
+	crc = frame_crc16(0, buf, n - 2);
+	if((buf[n - 2] != (crc & 0xFF)) || (buf[n - 1] != (crc >> 8))) return FRAME_ERR_CRC;
+	return n - FRAME_OVERHEAD;
+}
@@ -0,0 +1,109 @@
+/*
+ * frame.h
+ *
+ * This module is responsible for the binary frame format of the host
+ * protocol (see proto.h). It is plain C and also compiled into the host
+ * tools (tools/irlink.c).
+ *
+ * A frame on the wire is COBS encoded and terminated by 0x00:
+ *
+ *   COBS( type (1B) | seq (1B) | payload (0 ... FRAME_MAX_PAYLOAD B) | crc (2B, LE) ) 0x00
+ *
+ * crc is the CRC-16/XMODEM (poly 0x1021, init 0) of type, seq and payload.
+ * COBS removes every 0x00 from the frame, so 0x00 only appears as frame
+ * delimiter and a receiver can always resynchronize on it.
+ */
+
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+/** @brief Max number of payload bytes of a frame */
+#define FRAME_MAX_PAYLOAD 64
+/** @brief type, seq and crc */
+#define FRAME_OVERHEAD 4
+/** @brief Max size of a decoded frame */
+#define FRAME_MAX_DECODED (FRAME_MAX_PAYLOAD + FRAME_OVERHEAD)
+/** @brief Max size of an encoded frame (without the 0x00 delimiter) */
+#define FRAME_MAX_ENCODED (FRAME_MAX_DECODED + FRAME_MAX_DECODED / 254 + 1)
+
+/** @brief Frame types: requests (host -> device) */
+#define FRAME_PING 0x01			///< payload is echoed in the ACK
+#define FRAME_INFO 0x02			///< ACK payload: see proto.h
+#define FRAME_CLOSE 0x0F		///< end of the binary session, back to text commands
+#define FRAME_READ 0x10			///< library image export, see xfer.h
+#define FRAME_IMPORT_BEGIN 0x11	///< library image import, see xfer.h
+#define FRAME_IMPORT_DATA 0x12
+#define FRAME_IMPORT_END 0x13
+#define FRAME_LIB_INFO 0x14
+#define FRAME_STREAM_BEGIN 0x20	///< IR streaming mode, see stream.h
+#define FRAME_STREAM_DATA 0x21
+#define FRAME_STREAM_END 0x22
+#define FRAME_STREAM_STATUS 0x23
+#define FRAME_SNIFF_START 0x28	///< IR sniffer, see sniff.h
+#define FRAME_SNIFF_READ 0x29
+#define FRAME_SNIFF_STOP 0x2A
+/** @brief Frame types: responses (device -> host), seq of the request */
+#define FRAME_ACK 0x80			///< request executed, payload depends on the request
+#define FRAME_NAK 0x81			///< request rejected, payload: one FRAME_NAK_* byte
+#define FRAME_EVENT 0x82		///< without request, seq counts the events, see irdec.h
+
+/** @brief Reasons of a NAK */
+#define FRAME_NAK_CRC 1			///< broken frame (COBS, CRC or size), retransmit
+#define FRAME_NAK_TYPE 2		///< unknown request type
+#define FRAME_NAK_LENGTH 3		///< invalid payload for this request
+#define FRAME_NAK_STATE 4		///< request not possible now
+#define FRAME_NAK_CHECK 5		///< verification failed (e.g. image CRC)
+
+/** @brief Return codes of frame_unpack() */
+#define FRAME_ERR_COBS -1
+#define FRAME_ERR_SIZE -2
+#define FRAME_ERR_CRC -3
+
+/** @brief Update a CRC-16/XMODEM with a block of data
+ *
+ * @param crc CRC so far (0 to start)
+ * @param data Data
+ * @param len Number of bytes
+ * @return updated CRC
+ */
+uint16_t frame_crc16(uint16_t crc, const uint8_t *data, uint16_t len);
+
+/** @brief COBS encode a block (no delimiter is appended)
+ *
+ * @param src Data
+ * @param len Number of bytes
+ * @param dst (out) -> Encoded data (len + len / 254 + 1 bytes)
+ * @return Number of encoded bytes
+ */
+uint16_t cobs_encode(const uint8_t *src, uint16_t len, uint8_t *dst);
+
+/** @brief COBS decode a block (without delimiter), may decode in place
+ *
+ * @param src Encoded data
+ * @param len Number of encoded bytes
+ * @param dst (out) -> Decoded data (max. len - 1 bytes)
+ * @return Number of decoded bytes, -1 if the data is no valid COBS
+ */
+int16_t cobs_decode(const uint8_t *src, uint16_t len, uint8_t *dst);
+
+/** @brief Build an encoded frame
+ *
+ * @param type Frame type
+ * @param seq Sequence number
+ * @param payload Payload (may be 0 if len is 0)
+ * @param len Payload size (max. FRAME_MAX_PAYLOAD)
+ * @param out (out) -> Encoded frame incl. delimiter (FRAME_MAX_ENCODED + 1 bytes)
+ * @return Number of bytes to send
+ */
+uint8_t frame_pack(uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t len, uint8_t *out);
+
+/** @brief Decode and check a received frame (in place)
+ *
+ * @param buf Encoded frame without delimiter, the decoded frame is
+ * stored here: type, seq, payload
+ * @param len Number of encoded bytes
+ * @return Payload size (payload starts at buf + 2), FRAME_ERR_* otherwise
+ */
+int16_t frame_unpack(uint8_t *buf, uint16_t len);
+
+#endif /* _FRAME_H_ */
@@ -16,18 +16,10 @@ volatile uint8_t pulsing = 0;
 volatile int8_t NRcheck = 6;
 volatile uint16_t NRcount = 0;
 
-/** @brief Replay an IR command
- * 
- * This function replays a command with the given timings from ir
- * array.
- * 
- * @param ir Pointer to array, where the timings are.
- * @return 0 on success, error code otherwise
- * 
- * TBD: implement error codes
- */
- 
- //Enables the timer overflow interrupt
+static uint16_t *record_ir;						//target of the running recording
+static uint8_t record_running = 0;				//ir_record_start() .. result of ir_record_poll()
+
+//Enables the timer overflow interrupt
 void startTimer0(){ TIMSK0 |= (1<<TOIE0); }
 
 //Disables the timer overflow interrupt
@@ -52,42 +44,138 @@ void timer0conf(uint8_t mode){
 }
 
 uint8_t ir_play_command(uint16_t * ir){
+	ir_source_t src;
+	ir_source_ram(&src, ir);
+	return ir_play_source(&src);
+}
+
+//replay source for a timing array in RAM (terminated by 1)
+static uint8_t ram_read(ir_source_t *src, uint16_t offset, uint16_t *buf, uint8_t count){
+	const uint16_t *ir = src->data;
+	uint8_t n = 0;
+	while((offset + n < src->len) && (n < count)){ buf[n] = ir[offset + n]; n++; }
+	return n;
+}
+
+void ir_source_ram(ir_source_t *src, uint16_t *ir){
+	uint16_t len = 0;
+	while((len < MAX_IR_EDGES) && (ir[len] != 1)){ len++; }
+	src->read = ram_read;
+	src->data = ir;
+	src->addr = 0;
+	src->len = len;
+}
+
+//replay source for a timing array in flash
+static uint8_t progmem_read(ir_source_t *src, uint16_t offset, uint16_t *buf, uint8_t count){
+	const uint16_t *ir = src->data;
+	uint8_t n = 0;
+	while((offset + n < src->len) && (n < count)){ buf[n] = pgm_read_word(&ir[offset + n]); n++; }
+	return n;
+}
+
+void ir_source_progmem(ir_source_t *src, const uint16_t *ir, uint16_t len){
+	src->read = progmem_read;
+	src->data = ir;
+	src->addr = 0;
+	src->len = len;
+}
+
+//pulseCount is updated in the timer0 ISR, read it atomically
+static uint16_t elapsed(){
+	uint16_t t;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE){ t = pulseCount; }
+	return t;
+}
+
+#define NO_REFILL 2								//no chunk is refilled
+
+uint8_t ir_play_source(ir_source_t *src){
+	uint16_t chunk[2][IR_CHUNK_EDGES];				//double buffer: one is emitted, one is refilled
+	uint8_t fill[2];
+	uint8_t cur = 0;
+	uint8_t pos = 0;
+	uint8_t refill = NO_REFILL;						//chunk being refilled
+	uint8_t end = 0;								//the source has no more timings
+	uint8_t stalled = 0;
+	uint16_t q = 0;									//overall edge number (odd -> mark, even -> space)
+	uint16_t next;									//offset of the next timing to fetch
+	uint8_t n;
+	
+	src->emitted = 0;
+	src->stalls = 0;
+	if(record_running){ return IR_PLAY_BUSY; }			//Timer0 is in use
+	n = src->read(src, 0, chunk[0], IR_CHUNK_EDGES);
+	if((n == 0) || (n == IR_SOURCE_WAIT)){ return IR_PLAY_EMPTY; }
+	fill[0] = n;
+	fill[1] = 0;
+	next = n;
+	if(n < IR_CHUNK_EDGES){ end = 1; }
+	else {
+		n = src->read(src, next, chunk[1], IR_CHUNK_EDGES);
+		if(n == IR_SOURCE_WAIT){ refill = 1; }
+		else {
+			fill[1] = n;
+			next += n;
+			if(n < IR_CHUNK_EDGES){ end = 1; }
+		}
+	}
+	
 	timer0conf(0);
-	DDRB |= (1<<0); //CHECKING
-	PORTB |= (1<<0); //CHECKING
 	DDRD |= (1<<7);
 	PORTD &= ~(1<<7);
-	pulse(ir);
-	return 0;
-}
-
-void pulse(uint16_t *ir){
-	uint8_t q = 0;
-	uint8_t NOrep = 0;
+	pulseCount = 0;
 	startTimer0();
 	NRcheck = 50;
-	while(ir[q] != 1){
-		if((q % 2) == 1){
-			if(!NOrep){
-				PORTD &= ~(1<<7);
-				PORTB &= ~(1<<0); 	//CHECKING
+	while(1){
+		if(pos >= fill[cur]){
+			if(fill[cur] >= IR_CHUNK_EDGES){			//next chunk
+				cur = !cur;
+				pos = 0;
+				if((refill == NO_REFILL) && !end){ refill = !cur; fill[!cur] = 0; }
+				continue;
+			}
+			if(refill != cur){ break; }				//short chunk -> end of command
+			//underrun: the current edge is stretched until the timing arrives
+			if(!stalled){ src->stalls++; }
+			stalled = 1;
+		} else {
+			stalled = 0;
+			if((q % 2) == 1){
 				pulsing = 1;
-				NOrep = 1;
+			} else {
+				pulsing = 0;
+				PORTD &= ~(1<<7);
 			}
-			if(pulseCount >= ir[q]){ q++; pulseCount = 0; }
 		}
-		if((q % 2) == 0){
-			if(NOrep){
-				
-				PORTD &= ~(1<<7);
-				PORTB |= (1<<0);   //CHECKING
-				pulsing = 0;
-				NOrep = 0;
+		//prefetch the next chunk while this chunk is running, a few timings
+		//per edge (a slow source, e.g. I2C, must not stretch the edge)
+		if(refill != NO_REFILL){
+			n = src->read(src, next, &chunk[refill][fill[refill]], IR_REFILL_EDGES);
+			if(n == IR_SOURCE_WAIT){ n = 0; }
+			else if(n < IR_REFILL_EDGES){ end = 1; }
+			fill[refill] += n;
+			next += n;
+			if(end){ refill = NO_REFILL; }
+			else if(fill[refill] >= IR_CHUNK_EDGES){
+				//the chunk being emitted is complete (it was late): refill the other one
+				if(refill == cur){ refill = !cur; fill[refill] = 0; }
+				else { refill = NO_REFILL; }
 			}
-			if(pulseCount >= ir[q]){ q++; pulseCount = 0; }
 		}
+		if(stalled){
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE){ pulseCount = 0; }
+			continue;
+		}
+		while(elapsed() < chunk[cur][pos]){}
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE){ pulseCount = 0; }
+		src->emitted++;
+		q++;
+		pos++;
 	}
+	pulsing = 0;
 	stopTimer0();
+	return IR_PLAY_OK;
 }
 
 ISR(TIMER0_OVF_vect){  								//timer0 interrupt for 38kHz pulse and error handling
@@ -115,71 +203,124 @@ ISR(TIMER0_OVF_vect){  								//timer0 interrupt for 38kHz pulse and error hand
 		if(NRcount >= 71){							//since prescaler = 64; 71 * 64 = 4.544 microseconds
 			stopTimer0();
 			stopTimer1();
-			ir_timings[recorded+1] = 1;
+			ir_timings[recorded] = 1;				//terminate the timings
 			NRcheck = 4;
 		}
 	}
 }
 
-/** @brief Record an IR command
- * 
- * This function records an IR command to the given uint16 array pointer.
- * It returns when the record is finished (either OK or with error).
- * 
- * @param ir Pointer to array, where the timings should be stored
- * @return 0 on success, error code otherwise
- * 
- * TBD: implement error codes (example: no IR command recorded)
- */
- 
 //Timer 1 configuration: falling edge, normal mode, prescaler of 64 (4 us)
 //ICNC1 ICES1 – WGM13 WGM12 CS12 (CS11) (CS10) -> falling edge detection
-void timer1conf(){ TCCR1B |= 0b000000011; }
+//(assigned completely, the sniffer / bench may have left ICES1 or another prescaler)
+void timer1conf(){ TCCR1B = 0b000000011; }
 
 void startTimer1(){ TIMSK1 |= (1<<ICIE1); } 		//enables timer interrupt
 
 void stopTimer1(){ TIMSK1 &= ~(1<<ICIE1); } 		//disables timer interrupt
  
-//return 1 on timeout
-//return 2, when exceeded MAX_IR_EDGES 
-//return 0 on success
-uint8_t ir_record_command(uint16_t * ir)
+/** @brief Start recording an IR command (non-blocking)
+ * 
+ * The ISRs capture the signal, ir_record_poll() tells when it is done.
+ * 
+ * @param ir Pointer to array, where the timings should be stored
+ * @return 0 if started, IR_RECORD_BUSY if a recording runs already
+ */
+uint8_t ir_record_start(uint16_t * ir)
 {
+	if(record_running){ return IR_RECORD_BUSY; }
+	sniff_stop();									//Timer1 is needed here
 	DDRB &= ~(1<<PB0);								//configure input capture pin as input
     PORTB |= (1<<PB0);								//activate input capture pin internal pullup
     
     edge = 2;
-    uint8_t loop = 1;
     
     timer0conf(1);
 	startTimer0();									//start error check
 	NRcheck = 1;									//checking for timeout
 	timer1conf();									//init timer1
 	startTimer1();									//start timer1 interrupt
-	uart_sendstring("start:\n\r");
+	ir_dump_cancel();								//ir_timings is overwritten
+	LOG(LOG_MOD_IR, LOG_DEBUG, "record start");
 	recorded = 0;
-	
-	while(loop){ if((NRcheck == 2) || (NRcheck == 4) || (NRcheck == 5)){loop = 0;} }
-	_delay_ms(10);
+	ir_timings[0] = 0;								//no space before the first mark
+	record_ir = ir;
+	record_running = 1;
+	return 0;
+}
+
+/** @brief Check the recording started with ir_record_start()
+ * 
+ * @return IR_RECORD_BUSY while it runs (or none was started), otherwise
+ *         (once) 0 on success, 1 on timeout (no signal within 10 s),
+ *         2 if the signal exceeded MAX_IR_EDGES
+ */
+uint8_t ir_record_poll()
+{
+	//NRcheck is set by the ISRs: 2 timeout, 4 end of signal, 5 MAX_IR_EDGES exceeded
+	if(!record_running){ return IR_RECORD_BUSY; }
+	if((NRcheck != 2) && (NRcheck != 4) && (NRcheck != 5)){ return IR_RECORD_BUSY; }
+	record_running = 0;
 	
 	if(NRcheck == 2){return 1;}
 	if(NRcheck == 5){return 2; }
-	if(NRcheck == 4){
-		uart_sendstring("\n\rEnd of Signal detected");
-		char array[6];
-		for(uint8_t u = 1; u < recorded; u++){
-			uart_sendstring("\r\n");
-			int_to_str(ir_timings[u], array);
-			ir[u] = ir_timings[u];
-			uart_sendstring(array);
-			_delay_ms(5);
-		}
-	}
-	_delay_ms(100);
+	LOG_VAL(LOG_MOD_IR, LOG_DEBUG, "End of Signal detected, edges", recorded);
+	//the timings are dumped later (ir_dump_start()), not here
+	if(record_ir != ir_timings){ memcpy(record_ir, ir_timings, (recorded + 1) * sizeof(uint16_t)); }
 	return 0;	
 }
 
+/** @brief Is a recording running? (Timer0/Timer1 in use, no replay) */
+uint8_t ir_recording(){
+	return record_running;
+}
+
+static const uint16_t *dump_ir;				//timings of the running dump
+static uint16_t dump_len;
+static uint16_t dump_pos;					//next timing to send, 0: header
+static uint8_t dump_active = 0;
+
+void ir_dump_start(const uint16_t *ir){
+	dump_len = 0;
+	while((dump_len < MAX_IR_EDGES) && (ir[dump_len] != 1)){ dump_len++; }
+	dump_ir = ir;
+	dump_pos = 0;
+	dump_active = 1;
+}
+
+void ir_dump_cancel(){
+	dump_active = 0;
+}
+
+uint8_t ir_dump_service(){
+	char s[12];
+	
+	if(!dump_active){ return 0; }
+	if(dump_pos == 0){
+		strcpy_P(s, PSTR("\r\nIR "));
+		fmt_hex(&s[5], dump_len ? dump_len - 1 : 0, 4);
+		s[9] = ':';
+		s[10] = 0;
+		if(uart_tx_free() < strlen(s)){ return 1; }
+		uart_sendstring(s);
+		dump_pos = 1;							//index 0 is the (empty) space before the first mark
+	}
+	//only as much as fits into the UART buffer, never wait for it
+	while(dump_pos < dump_len){
+		uint8_t n = 0;
+		if(((dump_pos - 1) % IR_DUMP_PER_LINE) == 0){ s[n++] = '\r'; s[n++] = '\n'; }
+		fmt_hex(&s[n], dump_ir[dump_pos], 4);
+		if(uart_tx_free() < n + 4){ return 1; }
+		uart_sendstring(s);
+		dump_pos++;
+	}
+	if(uart_tx_free() < 2){ return 1; }
+	uart_sendstring_P(PSTR("\r\n"));
+	dump_active = 0;
+	return 0;
+}
+
 ISR(TIMER1_CAPT_vect){
+	if(sniff_capture()){ return; }					//sniffer running, see sniff.c
 	TCNT1 = 0;
 	NRcheck = 3;
 	if(edge == 2){ edge = 1; TCCR1B |= (1<<ICES1); goto out;} //to ignore the value until the signal happens
@@ -12,40 +12,184 @@
 #define RECORD 1
 #define PLAY 2
 
+/** @brief Length of IR timings array
+ * @warning Size in bytes is double (we allocate this number of uint16_t)
+ * @note Also used by the host tools (tools/), which include this file.
+ */
+#define MAX_IR_EDGES 250
+
+/** @brief Max length of any IR command name
+ * 
+ * Please take care of the length, do not accept input names longer than this array!
+ */
+#define MAX_NAME_LEN 10
+
+/** @brief Number of timings fetched from a replay source at once
+ * 
+ * Replay keeps two chunks of this size: one is emitted while the other
+ * one is refilled from the source.
+ */
+#define IR_CHUNK_EDGES 16
+
+/** @brief Number of timings fetched per emitted edge while refilling
+ * 
+ * The refill is spread over several edges, so a slow source (I2C EEPROM:
+ * about 25 us per byte) never takes longer than the shortest edge.
+ * IR_CHUNK_EDGES must be a multiple of it.
+ */
+#define IR_REFILL_EDGES 4
+
+/** @brief NEC protocol timings in us
+ * 
+ * A NEC frame is: lead mark, lead space, 32 bits (address, inverted
+ * address, command, inverted command, each LSB first) and a stop mark.
+ * Each bit is a NEC_BIT_MARK followed by NEC_ZERO_SPACE or NEC_ONE_SPACE.
+ */
+#define NEC_LEAD_MARK 9000
+#define NEC_LEAD_SPACE 4500
+#define NEC_BIT_MARK 560
+#define NEC_ZERO_SPACE 560
+#define NEC_ONE_SPACE 1690
+/// timings of a NEC frame in ir_timings layout (leading space, 2 lead, 64 bit, stop mark)
+#define NEC_EDGES 68
+
+/** @brief Return codes of ir_play_command() / ir_play_source() */
+#define IR_PLAY_OK 0
+#define IR_PLAY_EMPTY 1
+#define IR_PLAY_BUSY 2		///< a recording runs (see ir_recording())
+
+/** @brief Return value of ir_record_poll(): the recording runs */
+#define IR_RECORD_BUSY 0xFF
+
+/** @brief Pause after a recording before it is replayed in ms (the
+ * receiver settles), a one shot task of the UI (see sched.h) */
+#define IR_RECORD_SETTLE_MS 10
+
+/** @brief Return value of ir_source_t.read: no timing yet, ask again later */
+#define IR_SOURCE_WAIT 0xFF
+
+typedef struct ir_source ir_source_t;
+
+/** @brief Replay source
+ * 
+ * A replay source delivers the timings of one command chunk by chunk,
+ * so a command can be replayed directly from the memory it is stored in
+ * (RAM, EEPROM, ...), without copying it to ir_timings first.
+ * Timings on even offsets are spaces, odd offsets are marks
+ * (same layout as ir_timings).
+ */
+struct ir_source
+{
+	/** Copy up to count timings starting at offset to buf.
+	 * Returns the number of copied timings, less than count only at the
+	 * end of the command. A source which receives its timings (stream.c)
+	 * returns IR_SOURCE_WAIT if it has less than count yet. */
+	uint8_t (*read)(ir_source_t *src, uint16_t offset, uint16_t *buf, uint8_t count);
+	const void *data;	///< backend specific (e.g. RAM pointer)
+	uint16_t addr;		///< backend specific (e.g. storage address)
+	uint16_t len;		///< number of timings of this command
+	uint32_t emitted;	///< timings emitted, counted by ir_play_source()
+	uint16_t stalls;	///< edges stretched waiting for the source (IR_SOURCE_WAIT)
+};
+
 void timer0conf(uint8_t mode);
 void startTimer0();
 void stopTimer0();
-void pulse(uint16_t *ir);
 
 void timer1conf();
 void startTimer1();
 void stopTimer1();
 uint16_t measure();
 
-/** @brief Record an IR command
+/** @brief Start recording an IR command (non-blocking)
  * 
- * This function records an IR command to the given uint16 array pointer.
- * It returns when the record is finished (either OK or with error).
+ * The ISRs capture the signal, ir_record_poll() tells when it is done.
  * 
  * @param ir Pointer to array, where the timings should be stored
- * @return 0 on success, error code otherwise
+ * @return 0 if started, IR_RECORD_BUSY if a recording runs already
+ */
+uint8_t ir_record_start(uint16_t * ir);
+
+/** @brief Check the recording started with ir_record_start()
  * 
- * TBD: implement error codes (example: no IR command recorded)
+ * @return IR_RECORD_BUSY while it runs (or none was started), otherwise
+ *         (once) 0 on success, 1 on timeout (no signal within 10 s),
+ *         2 if the signal exceeded MAX_IR_EDGES
  */
-uint8_t ir_record_command(uint16_t * ir);
+uint8_t ir_record_poll();
 
+/** @brief Is a recording running? (Timer0/Timer1 in use, no replay) */
+uint8_t ir_recording();
 
 /** @brief Replay an IR command
  * 
  * This function replays a command with the given timings from ir
- * array.
+ * array (see ir_play_source()).
  * 
- * @param ir Pointer to array, where the timings are.
- * @return 0 on success, error code otherwise
- * 
- * TBD: implement error codes
+ * @param ir Pointer to array, where the timings are (terminated by 1)
+ * @return IR_PLAY_OK on success, IR_PLAY_EMPTY if the array has no timings,
+ *         IR_PLAY_BUSY if a recording runs
  */
 uint8_t ir_play_command(uint16_t * ir);
 
+/** @brief Timings per line of a capture dump */
+#define IR_DUMP_PER_LINE 16
+
+/** @brief Start a dump of captured timings on the UART
+ * 
+ * Nothing is sent here, the dump is sent piece by piece by
+ * ir_dump_service(), so recording does not wait for the UART.
+ * Format (hex, timings in us, without the leading space at index 0):
+ * 
+ *   IR nnnn:
+ *   tttttttt... (IR_DUMP_PER_LINE timings of 4 digits per line)
+ * 
+ * @param ir Timing array, terminated by 1 (must stay valid during the dump)
+ */
+void ir_dump_start(const uint16_t *ir);
+
+/** @brief Stop a running dump (e.g. the timings are overwritten) */
+void ir_dump_cancel();
+
+/** @brief Send the next part of a dump (non-blocking)
+ * 
+ * Call this regularly (e.g. from the UI loop), it queues as much as
+ * fits into the UART transmit buffer.
+ * 
+ * @return 1 while the dump is not finished, 0 otherwise
+ */
+uint8_t ir_dump_service();
+
+/** @brief Init a replay source for a timing array in RAM
+ * 
+ * @param src Source to be initialized
+ * @param ir Timing array, terminated by 1 (as recorded)
+ */
+void ir_source_ram(ir_source_t *src, uint16_t *ir);
+
+/** @brief Init a replay source for a timing array in flash (PROGMEM)
+ * 
+ * The timings are read with pgm_read_word() during replay, nothing is
+ * copied to SRAM.
+ * 
+ * @param src Source to be initialized
+ * @param ir Timing array in flash (same layout as ir_timings, no terminator)
+ * @param len Number of timings
+ */
+void ir_source_progmem(ir_source_t *src, const uint16_t *ir, uint16_t len);
+
+/** @brief Replay an IR command from a replay source
+ * 
+ * The first chunk is fetched before the carrier starts, every further
+ * chunk is prefetched while the previous one is emitted. If the source
+ * has no timing yet when it is due (IR_SOURCE_WAIT), the current edge is
+ * stretched until it arrives (src->stalls).
+ * 
+ * @param src Initialized replay source
+ * @return IR_PLAY_OK on success, IR_PLAY_EMPTY if the source has no timings,
+ *         IR_PLAY_BUSY if a recording runs
+ */
+uint8_t ir_play_source(ir_source_t *src);
+
 	
 #endif /* _IR_H_ */
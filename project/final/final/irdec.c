@@ -0,0 +1,174 @@
+/*
+ * irdec.c
+ *
+ * This module is responsible for the IR event decoder (see irdec.h).
+ *
+ * NEC decoder as state machine, one interval per call. The timings are
+ * accepted with about +-25 % (receivers stretch marks and shorten spaces).
+ */
+
+#include "common.h"
+
+#if (IRDEC_NEC != IRLIB_NEC) || (IRDEC_NECX != IRLIB_NECX)
+#error "IRDEC_* protocols must match IRLIB_*"
+#endif
+
+/// interval range in ticks
+#define US(t) ((t) / SNIFF_TICK_US)
+#define IN(ticks, lo, hi) (((ticks) >= US(lo)) && ((ticks) <= US(hi)))
+
+#define LEAD_MARK(t) IN(t, 7000, 11000)
+#define LEAD_SPACE(t) IN(t, 3700, 5300)
+#define REPEAT_SPACE(t) IN(t, 1800, 2700)
+#define BIT_MARK(t) IN(t, 300, 850)
+#define ZERO_SPACE(t) IN(t, 300, 850)
+#define ONE_SPACE(t) IN(t, 1300, 2100)
+
+/// decoder states
+#define S_IDLE 0		///< waiting for a lead mark
+#define S_LEAD 1		///< lead mark seen, lead or repeat space follows
+#define S_BIT_MARK 2
+#define S_BIT_SPACE 3
+#define S_STOP 4		///< 32 bits received, stop mark follows
+#define S_REPEAT 5		///< repeat space seen, stop mark follows
+
+static uint8_t state = S_IDLE;
+static uint8_t bits;
+static uint32_t data;
+static uint8_t last[4];			///< protocol, address, command of the held key
+static uint8_t last_valid = 0;
+static uint32_t last_stamp;		///< end of the last frame of the held key
+static uint8_t hold;
+static uint8_t seq = 0;
+
+/// decoded events (seq + payload), filled by the capture ISR, sent by irdec_service()
+static uint8_t queue[IRDEC_QUEUE_LEN][1 + IRDEC_EVENT_SIZE];
+static volatile uint8_t queue_head = 0;
+static volatile uint8_t queue_tail = 0;
+
+static void event(uint8_t flags, uint32_t stamp)
+{
+	uint8_t next = (queue_head + 1) & (IRDEC_QUEUE_LEN - 1);
+	uint8_t *p = queue[queue_head];
+
+	//lost if the queue is full, the seq shows it
+	if(next == queue_tail)
+	{
+		seq++;
+		return;
+	}
+	p[0] = seq++;
+	memcpy(&p[1], last, 4);
+	p[5] = flags;
+	p[6] = hold;
+	for(uint8_t i = 0; i < 4; i++) p[7 + i] = stamp >> (8 * i);
+	queue_head = next;
+}
+
+//32 bits received: check and report the key
+static void frame_end(uint32_t stamp)
+{
+	uint8_t a = data, na = data >> 8, c = data >> 16, nc = data >> 24;
+
+	if((uint8_t)~c != nc) return;
+	last[0] = ((uint8_t)~a == na) ? IRDEC_NEC : IRDEC_NECX;
+	last[1] = a;
+	last[2] = (last[0] == IRDEC_NEC) ? 0 : na;
+	last[3] = c;
+	last_valid = 1;
+	last_stamp = stamp;
+	hold = 0;
+	event(0, stamp);
+}
+
+static void repeat_end(uint32_t stamp)
+{
+	if(!last_valid || (stamp - last_stamp > US(IRDEC_HOLD_US)))
+	{
+		last_valid = 0;
+		return;
+	}
+	last_stamp = stamp;
+	if(hold != 0xFF) hold++;
+	event(IRDEC_REPEAT, stamp);
+}
+
+/** @brief Reset the decoder (start of the event mode) */
+void irdec_reset()
+{
+	state = S_IDLE;
+	last_valid = 0;
+}
+
+/** @brief Send the queued events (non-blocking)
+ *
+ * Called from the event task of the main loop (see main.c), an event
+ * stays queued while the urgent buffer of the UART is full.
+ */
+void irdec_service()
+{
+	uint8_t out[FRAME_OVERHEAD + IRDEC_EVENT_SIZE + 2];
+
+	while(queue_tail != queue_head)
+	{
+		const uint8_t *p = queue[queue_tail];
+
+		if(uart_write_urgent(out, frame_pack(FRAME_EVENT, p[0], &p[1], IRDEC_EVENT_SIZE, out)) != UART_OK) return;
+		queue_tail = (queue_tail + 1) & (IRDEC_QUEUE_LEN - 1);
+	}
+}
+
+/** @brief Decode one captured interval (called from the capture ISR)
+ *
+ * @param ticks Length of the interval (SNIFF_TICK_US)
+ * @param mark 1: mark, 0: space
+ * @param stamp Timestamp of the end of the interval (SNIFF_TICK_US)
+ */
+void irdec_feed(uint32_t ticks, uint8_t mark, uint32_t stamp)
+{
+	switch(state)
+	{
+		case S_LEAD:
+			if(!mark && LEAD_SPACE(ticks))
+			{
+				bits = 0;
+				data = 0;
+				state = S_BIT_MARK;
+				return;
+			}
+			if(!mark && REPEAT_SPACE(ticks))
+			{
+				state = S_REPEAT;
+				return;
+			}
+			break;
+		case S_BIT_MARK:
+			if(mark && BIT_MARK(ticks))
+			{
+				state = S_BIT_SPACE;
+				return;
+			}
+			break;
+		case S_BIT_SPACE:
+			if(!mark && (ZERO_SPACE(ticks) || ONE_SPACE(ticks)))
+			{
+				if(ONE_SPACE(ticks)) data |= 1UL << bits;
+				bits++;
+				state = (bits == 32) ? S_STOP : S_BIT_MARK;
+				return;
+			}
+			break;
+		case S_STOP:
+		case S_REPEAT:
+			if(mark && BIT_MARK(ticks))
+			{
+				if(state == S_STOP) frame_end(stamp);
+				else repeat_end(stamp);
+				state = S_IDLE;
+				return;
+			}
+			break;
+	}
+	//no match: this interval may start the next frame
+	state = (mark && LEAD_MARK(ticks)) ? S_LEAD : S_IDLE;
+}
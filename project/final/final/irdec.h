@@ -0,0 +1,65 @@
+/*
+ * irdec.h
+ *
+ * This module is responsible for the IR event decoder: the intervals
+ * captured by the sniffer (sniff.h, started with mode SNIFF_EVENTS) are
+ * decoded while they arrive, every recognized key is sent to the host as
+ * FRAME_EVENT frame (device -> host without request, the seq counts the
+ * events, so the host sees lost ones):
+ *
+ *   protocol (1B) | address (2B) | command (1B) | flags (1B) | hold (1B) | time (4B)
+ *
+ *   protocol: IRDEC_NEC (8 bit address) or IRDEC_NECX (16 bit address)
+ *   flags:    IRDEC_REPEAT for a repeat code (key held down)
+ *   hold:     number of repeat codes since the key frame (max. 255)
+ *   time:     end of the frame in SNIFF_TICK_US ticks (32 bit, wrapping)
+ *
+ * (multi byte values little endian)
+ *
+ * Latency: the frame is complete with the capture of its stop mark, the
+ * event is decoded in this capture interrupt and queued (IRDEC_QUEUE_LEN
+ * events). The event task (irdec_service(), every 1 ms) packs it and
+ * queues it with uart_write_urgent(): it is on the wire after the task
+ * ran (1 ms plus the longest task in front of it), at most one frame in
+ * progress (max. FRAME_MAX_ENCODED + 1 bytes, 0.72 ms at 1 Mbaud) and the
+ * event frame itself (0.16 ms).
+ */
+
+#ifndef _IRDEC_H_
+#define _IRDEC_H_
+
+/** @brief Protocols, same values as IRLIB_NEC / IRLIB_NECX (irlib.h) */
+#define IRDEC_NEC 0
+#define IRDEC_NECX 1
+
+/** @brief Event flags */
+#define IRDEC_REPEAT 0x01
+
+/** @brief Size of the event payload */
+#define IRDEC_EVENT_SIZE 10
+
+/** @brief Events queued between the capture ISR and irdec_service() (power of 2) */
+#define IRDEC_QUEUE_LEN 4
+
+/** @brief Max time between two frames of a held key in us (NEC: 108 ms) */
+#define IRDEC_HOLD_US 150000UL
+
+/** @brief Reset the decoder (start of the event mode) */
+void irdec_reset();
+
+/** @brief Send the queued events (non-blocking)
+ *
+ * Called from the event task of the main loop (see main.c), an event
+ * stays queued while the urgent buffer of the UART is full.
+ */
+void irdec_service();
+
+/** @brief Decode one captured interval (called from the capture ISR)
+ *
+ * @param ticks Length of the interval (SNIFF_TICK_US)
+ * @param mark 1: mark, 0: space
+ * @param stamp Timestamp of the end of the interval (SNIFF_TICK_US)
+ */
+void irdec_feed(uint32_t ticks, uint8_t mark, uint32_t stamp);
+
+#endif /* _IRDEC_H_ */
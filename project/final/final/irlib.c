@@ -0,0 +1,138 @@
+/*
+ * irlib.c
+ *
+ * This module is responsible for the built-in command library.
+ *
+ * See irlib.h, the table itself is generated into irlib_table.h.
+ */
+
+#include "common.h"
+#include "irlib_table.h"
+
+/// byte n (0..3) of the NEC frame of a library entry
+static uint8_t nec_byte(ir_source_t *src, uint8_t n)
+{
+	const uint16_t *data = src->data;
+	uint16_t address = pgm_read_word(&data[0]);
+	uint8_t command = pgm_read_word(&data[1]);
+
+	switch(n)
+	{
+		case 0: return address;
+		case 1: return (src->addr == IRLIB_NECX) ? (address >> 8) : ~address;
+		case 2: return command;
+		default: return ~command;
+	}
+}
+
+//replay source generating the NEC timings on the fly
+static uint8_t nec_read(ir_source_t *src, uint16_t offset, uint16_t *buf, uint8_t count)
+{
+	uint8_t n = 0;
+
+	while((offset + n < NEC_EDGES) && (n < count))
+	{
+		uint16_t k = offset + n;
+		uint8_t bit;
+
+		if(k == 0) buf[n] = 0;
+		else if(k == 1) buf[n] = NEC_LEAD_MARK;
+		else if(k == 2) buf[n] = NEC_LEAD_SPACE;
+		else if(k % 2) buf[n] = NEC_BIT_MARK;
+		else
+		{
+			bit = (k - 4) / 2;
+			buf[n] = (nec_byte(src, bit / 8) & (1 << (bit % 8))) ? NEC_ONE_SPACE : NEC_ZERO_SPACE;
+		}
+		n++;
+	}
+	return n;
+}
+
+static void entry_read(uint16_t index, irlib_entry_t *entry)
+{
+	memcpy_P(entry, &irlib_entries[index], sizeof(irlib_entry_t));
+}
+
+/** @brief Get number of built-in commands
+ *
+ * @return number of commands in the library
+ */
+uint16_t irlib_get_command_count()
+{
+	return IRLIB_COUNT;
+}
+
+/** @brief Get index for a name
+ *
+ * Binary search over the sorted library.
+ *
+ * @param name Name of the command ("device.button")
+ * @return -1 if not found, index otherwise
+ */
+int16_t irlib_get_command_index(const char * name)
+{
+	int16_t low = 0;
+	int16_t high = IRLIB_COUNT - 1;
+	irlib_entry_t entry;
+
+	while(low <= high)
+	{
+		int16_t mid = (low + high) / 2;
+		int cmp;
+
+		entry_read(mid, &entry);
+		cmp = strcmp_P(name, &irlib_names[entry.name]);
+		if(cmp == 0) return mid;
+		if(cmp < 0) high = mid - 1;
+		else low = mid + 1;
+	}
+	return -1;
+}
+
+/** @brief Get name for index
+ *
+ * @param index Index of the command
+ * @param name (out) -> Pointer where the name is stored (IRLIB_NAME_LEN bytes)
+ * @return Length of the name string, 0 when there is no command at the index.
+ */
+uint8_t irlib_get_command_name(uint16_t index, char * name)
+{
+	irlib_entry_t entry;
+
+	if(index >= IRLIB_COUNT) return 0;
+	entry_read(index, &entry);
+	strncpy_P(name, &irlib_names[entry.name], IRLIB_NAME_LEN - 1);
+	name[IRLIB_NAME_LEN - 1] = 0;
+	return strlen(name);
+}
+
+/** @brief Open a built-in command for replay
+ *
+ * Initializes a replay source which reads (or, for protocol entries,
+ * generates) the timings directly from flash, see ir_play_source().
+ *
+ * @param index Which command to open
+ * @param src (out) -> replay source
+ * @return IRLIB_OK when successful, IRLIB_ERR_INDEX otherwise
+ */
+uint8_t irlib_open_command(uint16_t index, ir_source_t * src)
+{
+	irlib_entry_t entry;
+
+	if(index >= IRLIB_COUNT) return IRLIB_ERR_INDEX;
+	entry_read(index, &entry);
+
+	if(entry.protocol == IRLIB_RAW)
+	{
+		ir_source_progmem(src, &irlib_data[entry.data], entry.len);
+	}
+	else
+	{
+		src->read = nec_read;
+		src->data = &irlib_data[entry.data];
+		src->addr = entry.protocol;
+		src->len = NEC_EDGES;
+	}
+	return IRLIB_OK;
+}
@@ -0,0 +1,78 @@
+/*
+ * irlib.h
+ *
+ * This module is responsible for the built-in command library.
+ *
+ * The library lives in flash (PROGMEM) and is generated at build time
+ * from the text database irlib.txt (see "make library" and
+ * tools/irlibgen.c). It is never copied to SRAM or EEPROM, commands are
+ * replayed straight from flash through a replay source (ir_source_t).
+ *
+ * The entries are sorted by name ("device.button"), so a name is found
+ * by binary search.
+ */
+
+#ifndef _IRLIB_H_
+#define _IRLIB_H_
+
+/** @brief Max length of a library command name ("device.button") incl. \0 */
+#define IRLIB_NAME_LEN 17
+
+/** @brief Protocols of the library entries
+ *
+ * IRLIB_NEC:  data = address (8 bit), command (8 bit)
+ * IRLIB_NECX: data = address (16 bit, extended NEC), command (8 bit)
+ * IRLIB_RAW:  data = timings (same layout as ir_timings, no terminator)
+ */
+#define IRLIB_NEC 0
+#define IRLIB_NECX 1
+#define IRLIB_RAW 2
+
+/** @brief Return codes of irlib_open() */
+#define IRLIB_OK 0
+#define IRLIB_ERR_INDEX 1
+
+/** @brief One entry of the library table (in flash) */
+typedef struct
+{
+	uint16_t name;		///< offset of the name in the name pool
+	uint8_t protocol;	///< IRLIB_NEC, IRLIB_NECX or IRLIB_RAW
+	uint8_t len;		///< number of data words
+	uint16_t data;		///< offset of the data in the data pool
+} irlib_entry_t;
+
+/** @brief Get number of built-in commands
+ *
+ * @return number of commands in the library
+ */
+uint16_t irlib_get_command_count();
+
+/** @brief Get index for a name
+ *
+ * Binary search over the sorted library.
+ *
+ * @param name Name of the command ("device.button")
+ * @return -1 if not found, index otherwise
+ */
+int16_t irlib_get_command_index(const char * name);
+
+/** @brief Get name for index
+ *
+ * @param index Index of the command
+ * @param name (out) -> Pointer where the name is stored (IRLIB_NAME_LEN bytes)
+ * @return Length of the name string, 0 when there is no command at the index.
+ */
+uint8_t irlib_get_command_name(uint16_t index, char * name);
+
+/** @brief Open a built-in command for replay
+ *
+ * Initializes a replay source which reads (or, for protocol entries,
+ * generates) the timings directly from flash, see ir_play_source().
+ *
+ * @param index Which command to open
+ * @param src (out) -> replay source
+ * @return IRLIB_OK when successful, IRLIB_ERR_INDEX otherwise
+ */
+uint8_t irlib_open_command(uint16_t index, ir_source_t * src);
+
+#endif /* _IRLIB_H_ */
@@ -0,0 +1,131 @@
+/*
+ * keys.c
+ *
+ * This module is responsible for the buttons (see keys.h).
+ */
+
+#include "common.h"
+
+/// S1..S4 on PD2..PD5 (PCINT18..21)
+#define KEYS_SHIFT 2
+#define KEYS_PINS (((1 << KEYS_COUNT) - 1) << KEYS_SHIFT)
+
+static volatile uint8_t queue[KEYS_QUEUE_SIZE];
+static volatile uint8_t head = 0;			//written by the tick
+static volatile uint8_t tail = 0;			//written by keys_get()
+
+static uint8_t raw;							//pin levels at the last edge
+static volatile uint16_t edge_ms[KEYS_COUNT];	//time of the last edge
+static volatile uint8_t unsettled = 0;		//buttons with an edge to debounce
+static volatile uint8_t stable = 0;			//debounced: pressed buttons
+static uint8_t long_sent = 0;				//KEYS_LONG posted for this press
+static uint16_t press_ms[KEYS_COUNT];
+
+static void post(uint8_t event)
+{
+	if((uint8_t)(head - tail) >= KEYS_QUEUE_SIZE) return;	//full: the user pressed faster than the UI reads
+	queue[head & (KEYS_QUEUE_SIZE - 1)] = event;
+	head++;
+}
+
+/** @brief Init the pins and the pin change interrupt
+ *
+ * Needs the tick (tick_init()).
+ */
+void keys_init()
+{
+	DDRD &= ~KEYS_PINS;
+	PORTD |= KEYS_PINS;		//pull-ups
+	raw = PIND & KEYS_PINS;
+	PCMSK2 |= KEYS_PINS;
+	PCIFR = (1 << PCIF2);
+	PCICR |= (1 << PCIE2);
+}
+
+/** @brief Fetch the next event (non-blocking)
+ * @return Event (button | type), KEYS_NONE if there is none
+ */
+uint8_t keys_get()
+{
+	uint8_t event;
+
+	if(head == tail) return KEYS_NONE;
+	event = queue[tail & (KEYS_QUEUE_SIZE - 1)];
+	tail++;
+	return event;
+}
+
+/** @brief Is there an event?
+ * @return 1 if keys_get() returns an event
+ */
+uint8_t keys_available()
+{
+	return head != tail;
+}
+
+/** @brief Drop all queued events
+ *
+ * E.g. presses while the UI was busy with a blocking action.
+ */
+void keys_clear()
+{
+	tail = head;
+}
+
+/** @brief Debounced level of a button
+ * @param key KEY_S1..KEY_S4
+ * @return 1 while pressed
+ */
+uint8_t keys_pressed(uint8_t key)
+{
+	return (stable >> key) & 1;
+}
+
+/** @brief Tick hook, called every ms from the tick interrupt
+ * @param now tick_ms()
+ */
+void keys_tick(uint16_t now)
+{
+	for(uint8_t key = 0; key < KEYS_COUNT; key++)
+	{
+		uint8_t bit = 1 << key;
+
+		if((unsettled & bit) && ((uint16_t)(now - edge_ms[key]) >= KEYS_DEBOUNCE_MS))
+		{
+			uint8_t pressed = (PIND & (bit << KEYS_SHIFT)) ? 0 : bit;
+
+			unsettled &= ~bit;
+			if(pressed != (stable & bit))
+			{
+				stable ^= bit;
+				if(pressed)
+				{
+					press_ms[key] = now;
+					long_sent &= ~bit;
+					post(KEYS_PRESS | key);
+				}
+				else post(KEYS_RELEASE | key);
+			}
+		}
+		if((stable & bit) && !(long_sent & bit) && ((uint16_t)(now - press_ms[key]) >= KEYS_LONG_MS))
+		{
+			long_sent |= bit;
+			post(KEYS_LONG | key);
+		}
+	}
+}
+
+//only stamp the edges, the tick decides
+ISR(PCINT2_vect)
+{
+	uint8_t pins = PIND & KEYS_PINS;
+	uint8_t changed = (pins ^ raw) >> KEYS_SHIFT;
+	uint16_t now = tick_ms();
+
+	raw = pins;
+	for(uint8_t key = 0; key < KEYS_COUNT; key++)
+	{
+		if(changed & (1 << key)) edge_ms[key] = now;
+	}
+	unsettled |= changed;
+}
@@ -0,0 +1,78 @@
+/*
+ * keys.h
+ *
+ * This module is responsible for the buttons S1..S4 (PD2..PD5, low
+ * active, internal pull-ups).
+ *
+ * Every edge raises the pin change interrupt, which only stamps the
+ * time of the edge. The millisecond tick (tick.h) takes a new level
+ * when the pin has been stable for KEYS_DEBOUNCE_MS and posts the
+ * events to a queue:
+ *
+ *   KEYS_PRESS    the button was pressed (after the debounce time)
+ *   KEYS_LONG     the button is still pressed after KEYS_LONG_MS (once)
+ *   KEYS_RELEASE  the button was released
+ *
+ * An event is the button number (KEY_S1..KEY_S4) or'ed with the type.
+ * Nobody waits for a release: the latency of a press is the debounce
+ * time plus at most 1 ms.
+ */
+
+#ifndef _KEYS_H_
+#define _KEYS_H_
+
+/** @brief Buttons */
+#define KEY_S1 0		///< PD2: menu, confirm the name
+#define KEY_S2 1		///< PD3: select
+#define KEY_S3 2		///< PD4: right
+#define KEY_S4 3		///< PD5: left
+#define KEYS_COUNT 4
+
+/** @brief Event types */
+#define KEYS_NONE 0x00
+#define KEYS_PRESS 0x10
+#define KEYS_LONG 0x20
+#define KEYS_RELEASE 0x40
+#define KEYS_KEY_MASK 0x0F
+
+/** @brief Timing in ms */
+#define KEYS_DEBOUNCE_MS 20
+#define KEYS_LONG_MS 1000
+
+/** @brief Number of queued events (power of 2) */
+#define KEYS_QUEUE_SIZE 8
+
+/** @brief Init the pins and the pin change interrupt
+ *
+ * Needs the tick (tick_init()).
+ */
+void keys_init();
+
+/** @brief Fetch the next event (non-blocking)
+ * @return Event (button | type), KEYS_NONE if there is none
+ */
+uint8_t keys_get();
+
+/** @brief Is there an event?
+ * @return 1 if keys_get() returns an event
+ */
+uint8_t keys_available();
+
+/** @brief Drop all queued events
+ *
+ * E.g. presses while the UI was busy with a blocking action.
+ */
+void keys_clear();
+
+/** @brief Debounced level of a button
+ * @param key KEY_S1..KEY_S4
+ * @return 1 while pressed
+ */
+uint8_t keys_pressed(uint8_t key);
+
+/** @brief Tick hook, called every ms from the tick interrupt
+ * @param now tick_ms()
+ */
+void keys_tick(uint16_t now);
+
+#endif /* _KEYS_H_ */
@@ -0,0 +1,102 @@
+/*
+ * log.c
+ *
+ * This module is responsible for the diagnostic messages (see log.h).
+ */
+
+#include "common.h"
+
+#if LOG_LEVEL > 0
+
+/// queued message, the text is formatted when it is sent
+typedef struct
+{
+	const char * text;
+	uint16_t val;
+	uint8_t flags;
+} log_msg_t;
+
+static log_msg_t queue[LOG_QUEUE_SIZE];
+static volatile uint8_t head = 0;	//written by log_put()
+static volatile uint8_t tail = 0;	//written by log_service()
+static volatile uint16_t dropped = 0;
+
+/// level prefix, index level - 1
+static const char level_chars[] PROGMEM = "EWID";
+
+/** @brief Queue a message, use the LOG() macros
+ *
+ * Safe in interrupts. Drops the message when the queue is full.
+ *
+ * @param text Text in flash
+ * @param val Number
+ * @param flags Level, LOG_HAS_VAL
+ */
+void log_put(const char * text, uint16_t val, uint8_t flags)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if((uint8_t)(head - tail) >= LOG_QUEUE_SIZE)
+		{
+			if(dropped != 0xFFFF) dropped++;
+		}
+		else
+		{
+			log_msg_t *msg = &queue[head & (LOG_QUEUE_SIZE - 1)];
+
+			msg->text = text;
+			msg->val = val;
+			msg->flags = flags;
+			head++;
+		}
+	}
+}
+
+/** @brief Send the queued messages
+ *
+ * Sends as many messages as fit into the UART buffer (never waits),
+ * called by the scheduler (task "log").
+ */
+void log_service()
+{
+	char s[FMT_DEC_LEN + 6];
+
+	while(tail != head)
+	{
+		log_msg_t *msg = &queue[tail & (LOG_QUEUE_SIZE - 1)];
+		uint8_t n = 0;
+
+		s[n++] = '\r';
+		s[n++] = '\n';
+		s[n++] = pgm_read_byte(&level_chars[(msg->flags & ~LOG_HAS_VAL) - 1]);
+		s[n++] = ' ';
+		s[n] = 0;
+		//all parts or nothing, the line is not torn apart
+		if(uart_tx_free() < n + strlen_P(msg->text) + 1 + FMT_DEC_LEN) return;
+		uart_sendstring(s);
+		uart_sendstring_P(msg->text);
+		if(msg->flags & LOG_HAS_VAL)
+		{
+			s[0] = ' ';
+			fmt_dec(&s[1], msg->val);
+			uart_sendstring(s);
+		}
+		tail++;
+	}
+	if(dropped && (uart_tx_free() >= 16 + FMT_DEC_LEN))
+	{
+		char num[FMT_DEC_LEN + 1];
+		uint16_t n;
+
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			n = dropped;
+			dropped = 0;
+		}
+		fmt_dec(num, n);
+		uart_sendstring_P(PSTR("\r\nW log dropped "));
+		uart_sendstring(num);
+	}
+}
+
+#endif
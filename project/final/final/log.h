@@ -0,0 +1,96 @@
+/*
+ * log.h
+ *
+ * This module is responsible for the diagnostic messages (UART).
+ *
+ * Every message has a module and a level, both are filtered at compile
+ * time (make LOG_LEVEL=4 LOG_MODULES=0x04):
+ *
+ *   LOG_LEVEL    highest level which is compiled in, 0 (default): none
+ *   LOG_MODULES  mask of the LOG_MOD_* which are compiled in
+ *
+ * A filtered message is a constant false condition, the compiler removes
+ * the call and the string: a release build (LOG_LEVEL=0) contains no
+ * logging code, no strings and no buffer (log.c is empty).
+ *
+ * An enabled message does not wait for the UART: log_put() only queues
+ * the pointer to the text (in flash) and the value, a few cycles, also
+ * in timing critical code. log_service() (a task, see sched.h) formats
+ * and sends the queued messages:
+ *
+ *   <level> text [value]     e.g. "D record end 68"
+ *
+ * When the queue is full, messages are dropped and counted.
+ *
+ * @note The messages share the UART with the CLI and the binary protocol
+ * (like any debug output), use them in debug builds only.
+ */
+
+#ifndef _LOG_H_
+#define _LOG_H_
+
+/** @brief Levels */
+#define LOG_ERR 1
+#define LOG_WARN 2
+#define LOG_INFO 3
+#define LOG_DEBUG 4
+
+/** @brief Modules (bit mask) */
+#define LOG_MOD_MAIN 0x01		///< main loop
+#define LOG_MOD_UI 0x02			///< menu and name input
+#define LOG_MOD_IR 0x04			///< IR record/replay
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL 0
+#endif
+#ifndef LOG_MODULES
+#define LOG_MODULES 0xFF
+#endif
+
+/** @brief Number of queued messages (power of 2) */
+#define LOG_QUEUE_SIZE 8
+
+/** @brief Message flag: the value is sent too */
+#define LOG_HAS_VAL 0x80
+
+/** @brief Is a message of this module and level compiled in? */
+#define LOG_ENABLED(module, level) ((LOG_LEVEL >= (level)) && (LOG_MODULES & (module)))
+
+/** @brief Log a message (text literal) */
+#define LOG(module, level, text) do { \
+	if(LOG_ENABLED(module, level)) log_put(PSTR(text), 0, (level)); \
+} while(0)
+
+/** @brief Log a message (text literal) with a number */
+#define LOG_VAL(module, level, text, val) do { \
+	if(LOG_ENABLED(module, level)) log_put(PSTR(text), (val), (level) | LOG_HAS_VAL); \
+} while(0)
+
+/** @brief Queue a message, use the LOG() macros
+ *
+ * Safe in interrupts. Drops the message when the queue is full.
+ * Only defined with LOG_LEVEL > 0: a call which is not removed at
+ * compile time fails to link.
+ *
+ * @param text Text in flash
+ * @param val Number
+ * @param flags Level, LOG_HAS_VAL
+ */
+void log_put(const char * text, uint16_t val, uint8_t flags);
+
+#if LOG_LEVEL > 0
+
+/** @brief Send the queued messages
+ *
+ * Sends as many messages as fit into the UART buffer (never waits),
+ * called by the scheduler (task "log").
+ */
+void log_service();
+
+#else
+
+#define log_service() do {} while(0)
+
+#endif
+
+#endif /* _LOG_H_ */
@@ -1,506 +1,519 @@
 /*
- * ir.c
- * 
- * This module is responsible for the infrared record / replay
- * 
- * TBD: extend this file header with infos & name
+ * menu.c
+ *
+ * This module is responsible for the user interface (see menu.h).
  */
 
 #include "common.h"
 
-#define BUTTONPD2 ((PIND & (1<<2)) == 0)
-#define BUTTONPD3 ((PIND & (1<<3)) == 0)
-#define BUTTONPD4 ((PIND & (1<<4)) == 0)
-#define BUTTONPD5 ((PIND & (1<<5)) == 0)
-
-/**@brief Init UI/LCD
- *
- *This function initializes the SPI interface
- *and displays the welcome message.
- */
-volatile int8_t selectedOption = -1;
-
-void button()
+/// UI states
+#define UI_MENU 0
+#define UI_RUN 1
+#define UI_NAME 2
+#define UI_MESSAGE 3
+#define UI_SETTINGS 4
+#define UI_BROWSE 5
+#define UI_RECORD 6
+#define UI_RECORDED 7
+
+/// one LCD row incl. \0
+#define UI_TEXT_LEN 17
+/// no command recorded yet
+#define UI_NO_COMMAND 0xFF
+
+/// menu item (in flash)
+typedef struct
 {
-	if (BUTTONPD2)
-	{
-		selectedOption++;
-		while (BUTTONPD2) {} //Solang der Button gepresst ist bleibt man bei der ausgewählten Option (Iteration wird verhindert)
-	}
+	char title[UI_TEXT_LEN];	///< row 0 while the item is selected
+	char busy[UI_TEXT_LEN];		///< row 1 while the action runs
+	uint8_t pick;				///< 1: the command is picked in the browser first
+	void (*run)();				///< action, returns to the menu or sets the next state
+} ui_item_t;
+
+static void run_record();
+static void run_replay();
+static void run_delete();
+static void run_browse();
+static void run_settings();
+
+static const ui_item_t items[] PROGMEM =
+{
+	{ "  >>>RECORD<<<", "RECORDING...", 0, run_record },
+	{ "  >>>REPLAY<<<", "REPLAYING...", 1, run_replay },
+	{ "  >>>DELETE<<<", "DELETING...", 1, run_delete },
+	{ "  >>>BROWSE<<<", "", 1, run_browse },
+	{ " >>>SETTINGS<<<", "", 0, run_settings },
+};
+
+#define UI_ITEMS (sizeof(items) / sizeof(items[0]))
+
+static uint8_t state = UI_MENU;
+static uint8_t item = UI_ITEMS;			//selected item, UI_ITEMS: none (welcome screen)
+static uint8_t redraw = 0;				//draw the menu item / settings in the next step
+static uint8_t message_task;			//one shot: end of the message
+static uint8_t recorded_task;			//one shot: replay of the recording
+static uint8_t current = UI_NO_COMMAND;	//command of replay / delete / browse
+static uint8_t dump = 1;				//setting: dump a recorded capture on the UART
+
+/// character picker of the name input: one page per entry, the cells
+/// row by row as shown on the LCD, ' ' is an empty cell (skipped).
+/// More characters or pages need no code changes, letters are stored
+/// in lower case.
+#define PICK_COLS 16
+#define PICK_CELLS (2 * PICK_COLS)
+
+static const char pick_pages[][PICK_CELLS + 1] PROGMEM =
+{
+	"ABCDEFGHIJKLMNOP"
+	"QRSTUVWXYZ      ",
+	"0123456789      "
+	"                ",
+};
+
+#define PICK_PAGES (sizeof(pick_pages) / sizeof(pick_pages[0]))
+
+static uint8_t pick_page;
+static uint8_t pick_cell;
+static uint8_t pick_drawn;				//page on the LCD, PICK_PAGES: none
+static uint8_t pick_len;				//length of the name (ir_name)
+
+/// command browser: the names are shown two at a time (one page per
+/// screen) and fetched from the storage when needed. Only the visible
+/// page and the next one in scroll direction are kept, page p in slot
+/// p & 1 (neighbouring pages never share a slot).
+#define BROWSE_ROWS 2
+#define BROWSE_NO_PAGE 0xFF
+
+static char browse_names[2][BROWSE_ROWS][MAX_NAME_LEN];
+static uint8_t browse_page[2];			//page in the slot, BROWSE_NO_PAGE: empty
+static uint8_t browse_count;			//commands in the library
+static uint8_t browse_sel;				//selected command
+static int8_t browse_dir;				//last scroll direction, the next page is prefetched
+
+/// next press event (KEYS_PRESS | key), KEYS_NONE if there is none
+/// (the menu acts on presses, releases and long presses are skipped)
+static uint8_t ui_press()
+{
+	uint8_t event;
 
-	if (selectedOption >= 3) //sobald Selected option größer als 3 ist, wird die Variable auf Null gesetzt um wieder bei record starten zu können 
+	while ((event = keys_get()) != KEYS_NONE)
 	{
-		selectedOption = 0;
+		if (event & KEYS_PRESS) return event;
 	}
-
-	_delay_ms(50);	 //Button Debouncing 
+	return KEYS_NONE;
 }
 
-void record()
-
+/// back to the selected menu item
+static void ui_menu()
 {
-	lcdClear();
-	lcdWriteString(0, 0, "  >>>RECORD<<<");
+	state = UI_MENU;
+	redraw = 1;
 }
 
-void replay()
-
+/// show a message (texts in flash, 0: the row is not changed),
+/// until a button is pressed or UI_MESSAGE_MS elapsed
+static void ui_message(const char *line0, const char *line1)
 {
-	lcdWriteString(0, 0, "  >>>REPLAY<<<");
+	if (line0) lcdWriteString_P(0, TWO_LINES_OFF, line0);
+	if (line1) lcdWriteString_P(1, TWO_LINES_OFF, line1);
+	sched_start(message_task, UI_MESSAGE_MS);
+	state = UI_MESSAGE;
 }
 
-void delete()
-
+/// message task: UI_MESSAGE_MS elapsed
+static void ui_message_end()
 {
-	lcdWriteString(0, 0, "  >>>DELETE<<<");
+	if (state == UI_MESSAGE) ui_menu();
 }
 
-uint8_t recording()
-
+/// move the cursor to the next (dir 1) or previous (dir -1) character,
+/// across the rows and pages
+static void pick_step(int8_t dir)
 {
-	lcdClear();
-	lcdWriteString(1, 0, "RECORDING...");
-	return 0;
+	do
+	{
+		if (dir > 0)
+		{
+			if (++pick_cell >= PICK_CELLS)
+			{
+				pick_cell = 0;
+				if (++pick_page >= PICK_PAGES) pick_page = 0;
+			}
+		}
+		else if (pick_cell-- == 0)
+		{
+			pick_cell = PICK_CELLS - 1;
+			pick_page = (pick_page ? pick_page : PICK_PAGES) - 1;
+		}
+	} while (pgm_read_byte(&pick_pages[pick_page][pick_cell]) == ' ');
 }
 
-uint8_t replaying()
-
+/// the name is complete: store the recorded command
+static void name_done()
 {
-	lcdClear();
-	lcdWriteString(1, 0, "REPLAYING...");
-	return 1;
-}
+	uint8_t ret;
 
-uint8_t deleting()
-
-{
+	ir_name[pick_len] = 0;
+	lcdCursorOnOff(CURSOR_OFF, POSITION_OFF);
 	lcdClear();
-	lcdWriteString(1, 0, "DELETING...");
-	return 2;
-}
+	lcdWriteString(0, TWO_LINES_OFF, ir_name);
+	LOG_VAL(LOG_MOD_UI, LOG_INFO, "name entered, length", pick_len);
 
-void ui_init()
-{
-	DDRD |= (0x3c);	//0011 1100
-	PORTD |= (0x3c); 
+	//new name -> appended
+	ret = eeprom_store_command(-1, ir_name, ir_timings);
+	if (ret == EEPROM_OK)
+	{
+		current = eeprom_get_command_index(ir_name);
+		ui_message(0, PSTR("SAVED!"));
+	}
+	else if (ret == EEPROM_ERR_FULL) ui_message(0, PSTR("MEMORY FULL"));
+	else ui_message(0, PSTR("ERROR"));
 
-	lcdSpiInit();
-	lcdInit();
-	lcdWriteString(0, 0, "WELCOME");
-	lcdWriteString(1, 0, "(press S1)");
-	uart_sendstring("\n\rWELCOME");
+	//dump the capture when the user is back in the menu
+	if (dump) ir_dump_start(ir_timings);
 }
 
-//TBD: call the init function of dogm_lcd
-
-//TBD: display welcome message.
-
-/**@brief Main UI/menu/LCD function
- *
- *This function is called each time when the program requests user input
- *This function blocks as long as no command is selected.
- *
- *When the function returns, the return value is a number for the
- *selected command. This number is used in main.c to do the corresponding
- *action (record/replay/delete).
- *
- *@param index This pointer is set here to have an index value for main.c
- *@param ir_name This string is set here to a command name (for store)
- *@return Selected command
- *
- *TBD: clearify the command return by using macros
- */
-
-uint8_t ui_get_selection(uint8_t *index, char *ir_name)
+/// name input: S3/S4 move the cursor right/left, S2 appends the
+/// character under the cursor, S1 (or a full name) finishes the input
+static void name_key(uint8_t key)
 {
-	//this delay is necessary, otherwise this function is called
-	// as fast as possible (flooding of the terminal)
-	_delay_ms(1000);
-	uint8_t var = 5; //in der Main Funktion
+	char c;
 
-	while (1)
+	if (key == (KEYS_PRESS | KEY_S3)) pick_step(1);
+	else if (key == (KEYS_PRESS | KEY_S4)) pick_step(-1);
+	else if (key == (KEYS_PRESS | KEY_S2))
 	{
-		button();
-
-		if (selectedOption == 0)  
-		{
-			record();
-			if (BUTTONPD3) //mit S2 wird bestätigt welche der drei Optionen ausgeführt werden soll
-			{
-				_delay_ms(1000);
-				uart_sendstring("\n\rrecording...");
-				var = recording();
-			}
-		}
-		else if (selectedOption == 1)
-		{
-			replay();
-			if (BUTTONPD3)
-			{
-				uart_sendstring("\n\rreplaying...");
-				var = replaying();
-			}
-		}
-		else if (selectedOption == 2)
-		{
-			delete();
-			if (BUTTONPD3)
-			{
-				uart_sendstring("\n\rdeleting...");
-				var = deleting();
-			}
-		}
+		c = pgm_read_byte(&pick_pages[pick_page][pick_cell]);
+		if ((c >= 'A') && (c <= 'Z')) c += 'a' - 'A';
+		if (c != ' ') ir_name[pick_len++] = c;
+	}
 
-		if (var != 5) break; //breaked raus aus der while Loop sobald eines der Optionen gewählt wird
+	if ((key == (KEYS_PRESS | KEY_S1)) || (pick_len >= MAX_NAME_LEN - 1))
+	{
+		name_done();
+		return;
 	}
 
-	selectedOption = -1;
-	return var;
+	if (pick_page != pick_drawn)
+	{
+		lcdWriteString_P(0, TWO_LINES_ON, pick_pages[pick_page]);
+		LOG_VAL(LOG_MOD_UI, LOG_DEBUG, "alphabet page", pick_page);
+		pick_drawn = pick_page;
+	}
+	lcdSetCursor(pick_cell / PICK_COLS, pick_cell % PICK_COLS);
 }
 
-uint8_t Alphabet(char *name)
+static void name_start()
 {
+	pick_page = 0;
+	pick_cell = 0;
+	pick_drawn = PICK_PAGES;
+	pick_len = 0;
 	lcdClear();
-	uint8_t col = 0;
-	uint8_t row = 0;
-	uint8_t i = 0;
-	uint8_t page = 0;
-	uint8_t shown = 1;
+	lcdCursorOnOff(CURSOR_ON, POSITION_ON);
+	keys_clear();	//presses during the recording are stale
+	state = UI_NAME;
+	name_key(KEYS_NONE);
+}
 
-	lcdCursorOnOff(1, 1);
-	char arr[10];
+/// fetch the names of page p into its slot ("" behind the last command)
+static void browse_load(uint8_t p)
+{
+	uint8_t slot = p & 1;
+	uint8_t index = p * BROWSE_ROWS;
 
-	while (1)
+	for (uint8_t row = 0; row < BROWSE_ROWS; row++, index++)
 	{
-		out: lcdSetCursor(row, col);
-
-		if ((page == 0) && (shown))
-		{
-			lcdClear();
-			lcdWriteString(0, 0, "ABCDEFGHIJKLMNOP");
-			uart_sendstring("\n\rABCDEFGHIJKLMNOP");
-			lcdWriteString(1, 0, "QRSTUVWXYZ      ");
-			uart_sendstring("\n\rQRSTUVWXYZ");
-			shown = 0;
-		}
-		else if ((page == 1) && (shown))
+		if ((index >= browse_count) || (eeprom_get_command_name(index, browse_names[slot][row]) == 0))
 		{
-			lcdClear();
-			lcdWriteString(0, 0, "0123456789      ");
-			uart_sendstring("\n\r123456789");
-			shown = 0;
+			browse_names[slot][row][0] = 0;
 		}
+	}
+	browse_page[slot] = p;
+	LOG_VAL(LOG_MOD_UI, LOG_DEBUG, "browse page loaded", p);
+}
 
-		if (BUTTONPD4)	//Button nach rechts (S3)
-		{
-			_delay_ms(50);
-			while (BUTTONPD4) {}
-
-			col++;
-
-			if ((row == 0) && (col >= 16)) //Wird Reihe 0, Spalte 16 erreicht, gelangt man zu Reihe 1, Spalte 0
-			{
-				row = 1;
-				col = 0;
-			}
-
-			if ((row == 1) && (col >= 16)) //Wird Reihe 1, Spalte 16 erreicht, gelangt man zu Reihe 0, Spalte 0, Seite 1
-			{
-				col = 0;
-				row = 0;
-				shown = 1;
-				if (page == 1)
-				{
-					page = 0;
-					goto out;
-				}
-
-				page++;
-				if (page > 1) page = 0; 
-				if (page == 0) page = 1;
-			}
-		}
+/// page of the selected command, one row per command: ">003 name"
+static void browse_draw()
+{
+	uint8_t p = browse_sel / BROWSE_ROWS;
+	uint8_t index = p * BROWSE_ROWS;
+	char line[UI_TEXT_LEN];
 
-		if (BUTTONPD5)	//Button nach links (S4)
+	if (browse_page[p & 1] != p) browse_load(p);
+	for (uint8_t row = 0; row < BROWSE_ROWS; row++, index++)
+	{
+		line[0] = 0;
+		if (index < browse_count)
 		{
-			_delay_ms(50);
-			while (BUTTONPD5) {}
-
-			col--;
-
-			if ((row == 0) && (col <= 0))
-			{
-				row = 1;
-				col = 16;
-				shown = 1;
-				if (page == 0)
-				{
-					page = 1;
-					goto out;
-				}
-
-				page--;
-				if (page < 0) page = 1;
-				if (page == 1) page = 0;
-			}
-
-			if ((row == 1) && (col <= 0))
-			{
-				row = 0;
-				col = 16;
-			}
+			line[0] = (index == browse_sel) ? '>' : ' ';
+			fmt_dec_width(&line[1], index, 3, '0');
+			line[4] = ' ';
+			strcpy(&line[5], browse_names[p & 1][row]);
 		}
+		lcdWriteString(row, TWO_LINES_OFF, line);
+	}
+}
 
-		if (BUTTONPD3)	// Um Namen auswählen zu können (S2)
-		{
-			_delay_ms(50);
-			while (BUTTONPD3);
-			if ((row == 0) && (col == 0) && (page == 0))
-			{
-				arr[i] = 'a';
-				i++;
-			}
-
-			if ((row == 0) && (col == 1) && (page == 0))
-			{
-				arr[i] = 'b';
-				i++;
-			}
-
-			if ((row == 0) && (col == 2) && (page == 0))
-			{
-				arr[i] = 'c';
-				i++;
-			}
-
-			if ((row == 0) && (col == 3) && (page == 0))
-			{
-				arr[i] = 'd';
-				i++;
-			}
-
-			if ((row == 0) && (col == 4) && (page == 0))
-			{
-				arr[i] = 'e';
-				i++;
-			}
-
-			if ((row == 0) && (col == 5) && (page == 0))
-			{
-				arr[i] = 'f';
-				i++;
-			}
-
-			if ((row == 0) && (col == 6) && (page == 0))
-			{
-				arr[i] = 'g';
-				i++;
-			}
-
-			if ((row == 0) && (col == 7) && (page == 0))
-			{
-				arr[i] = 'h';
-				i++;
-			}
-
-			if ((row == 0) && (col == 8) && (page == 0))
-			{
-				arr[i] = 'i';
-				i++;
-			}
-
-			if ((row == 0) && (col == 9) && (page == 0))
-			{
-				arr[i] = 'j';
-				i++;
-			}
-
-			if ((row == 0) && (col == 10) && (page == 0))
-			{
-				arr[i] = 'k';
-				i++;
-			}
-
-			if ((row == 0) && (col == 11) && (page == 0))
-			{
-				arr[i] = 'l';
-				i++;
-			}
-
-			if ((row == 0) && (col == 12) && (page == 0))
-			{
-				arr[i] = 'm';
-				i++;
-			}
-
-			if ((row == 0) && (col == 13) && (page == 0))
-			{
-				arr[i] = 'n';
-				i++;
-			}
-
-			if ((row == 0) && (col == 14) && (page == 0))
-			{
-				arr[i] = 'o';
-				i++;
-			}
-
-			if ((row == 0) && (col == 15) && (page == 0))
-			{
-				arr[i] = 'p';
-				i++;
-			}
-
-			if ((row == 1) && (col == 0) && (page == 0))
-			{
-				arr[i] = 'q';
-				i++;
-			}
-
-			if ((row == 1) && (col == 1) && (page == 0))
-			{
-				arr[i] = 'r';
-				i++;
-			}
-
-			if ((row == 1) && (col == 2) && (page == 0))
-			{
-				arr[i] = 's';
-				i++;
-			}
-
-			if ((row == 1) && (col == 3) && (page == 0))
-			{
-				arr[i] = 't';
-				i++;
-			}
-
-			if ((row == 1) && (col == 4) && (page == 0))
-			{
-				arr[i] = 'u';
-
-				i++;
-			}
+/// nothing to draw: fetch the next page in scroll direction
+static void browse_prefetch()
+{
+	uint8_t pages = (browse_count + BROWSE_ROWS - 1) / BROWSE_ROWS;
+	uint8_t p = browse_sel / BROWSE_ROWS;
+	uint8_t next = (p + pages + browse_dir) % pages;
 
-			if ((row == 1) && (col == 5) && (page == 0))
-			{
-				arr[i] = 'v';
-				i++;
-			}
+	//wrapping around an odd number of pages: the slot is the visible one
+	if (((next & 1) != (p & 1)) && (browse_page[next & 1] != next)) browse_load(next);
+}
 
-			if ((row == 1) && (col == 6) && (page == 0))
-			{
-				arr[i] = 'w';
-				i++;
-			}
+static void browse_start()
+{
+	browse_count = eeprom_get_command_count();
+	if (browse_count == 0)
+	{
+		lcdClear();
+		ui_message(PSTR("NO COMMANDS"), 0);
+		return;
+	}
+	browse_page[0] = BROWSE_NO_PAGE;
+	browse_page[1] = BROWSE_NO_PAGE;
+	browse_sel = (current < browse_count) ? current : 0;
+	browse_dir = 1;
+	state = UI_BROWSE;
+	browse_draw();
+}
 
-			if ((row == 1) && (col == 7) && (page == 0))
-			{
-				arr[i] = 'x';
-				i++;
-			}
+/// show the busy text, the action of the item runs in the next step
+static void ui_run()
+{
+	LOG_VAL(LOG_MOD_UI, LOG_DEBUG, "menu item", item);
+	lcdClear();
+	lcdWriteString_P(1, TWO_LINES_OFF, items[item].busy);
+	state = UI_RUN;
+}
 
-			if ((row == 1) && (col == 8) && (page == 0))
-			{
-				arr[i] = 'y';
-				i++;
-			}
+/// browser: S3/S4 select the next/previous command, S2 runs the action
+/// of the menu item with it, S1 goes back to the menu
+static void browse_key(uint8_t key)
+{
+	if (key == (KEYS_PRESS | KEY_S3))
+	{
+		browse_sel = (browse_sel + 1 < browse_count) ? browse_sel + 1 : 0;
+		browse_dir = 1;
+	}
+	else if (key == (KEYS_PRESS | KEY_S4))
+	{
+		browse_sel = browse_sel ? browse_sel - 1 : browse_count - 1;
+		browse_dir = -1;
+	}
+	else if (key == (KEYS_PRESS | KEY_S2))
+	{
+		current = browse_sel;
+		ui_run();
+		return;
+	}
+	else if (key == (KEYS_PRESS | KEY_S1))
+	{
+		ui_menu();
+		return;
+	}
+	else
+	{
+		browse_prefetch();
+		return;
+	}
+	browse_draw();
+}
 
-			if ((row == 1) && (col == 9) && (page == 0))
-			{
-				arr[i] = 'z';
-				i++;
-			}
+static void run_record()
+{
+	if (ir_record_start(ir_timings) != 0)
+	{
+		lcdClear();
+		ui_message(PSTR("BUSY"), 0);
+		return;
+	}
+	state = UI_RECORD;
+}
 
-			if ((row == 0) && (col == 0) && (page == 1))
-			{
-				arr[i] = '0';
-				i++;
-			}
+/// recording: wait for the result (the ISRs capture the signal)
+static void record_step()
+{
+	uint8_t ret = ir_record_poll();
 
-			if ((row == 0) && (col == 1) && (page == 1))
-			{
-				arr[i] = '1';
-				i++;
-			}
+	if (ret == IR_RECORD_BUSY) return;
+	if (ret == 0)
+	{
+		//replayed after IR_RECORD_SETTLE_MS
+		sched_start(recorded_task, IR_RECORD_SETTLE_MS);
+		state = UI_RECORDED;
+		return;
+	}
 
-			if ((row == 0) && (col == 2) && (page == 1))
-			{
-				arr[i] = '2';
-				i++;
-			}
+	ui_menu();
+	lcdClear();
+	if (ret == 1)
+	{
+		LOG(LOG_MOD_UI, LOG_WARN, "No Signal detected (10s)");
+		ui_message(PSTR("timeout"), 0);
+	}
+	else if (ret == 2)
+	{
+		LOG(LOG_MOD_UI, LOG_WARN, "MAX_IR_LENGTH reached!");
+		ui_message(PSTR("EXCEEDED"), PSTR("MAX LENGTH"));
+	}
+	else
+	{
+		LOG_VAL(LOG_MOD_UI, LOG_ERR, "error in recording the signal", ret);
+		ui_message(PSTR("ERROR"), 0);
+	}
+}
 
-			if ((row == 0) && (col == 3) && (page == 1))
-			{
-				arr[i] = '3';
-				i++;
-			}
+/// recorded task: replay the recording, then the name input
+static void ui_recorded()
+{
+	if (state != UI_RECORDED) return;
+	ir_play_command(ir_timings);
+	name_start();
+}
 
-			if ((row == 0) && (col == 4) && (page == 1))
-			{
-				arr[i] = '4';
-				i++;
-			}
+static void run_replay()
+{
+	ir_source_t src;
 
-			if ((row == 0) && (col == 5) && (page == 1))
-			{
-				arr[i] = '5';
-				i++;
-			}
+	//streamed from the EEPROM during replay, no need to load it to ir_timings
+	if (eeprom_open_command(current, &src) != EEPROM_OK)
+	{
+		lcdClear();
+		ui_message(PSTR("NO COMMAND"), 0);
+		return;
+	}
+	//a recording of the CLI (rec) holds the timers
+	if (ir_play_source(&src) == IR_PLAY_BUSY)
+	{
+		lcdClear();
+		ui_message(PSTR("BUSY"), 0);
+	}
+}
 
-			if ((row == 0) && (col == 6) && (page == 1))
-			{
-				arr[i] = '6';
-				i++;
-			}
+static void run_delete()
+{
+	if (eeprom_delete_command(current) != EEPROM_OK)
+	{
+		lcdClear();
+		ui_message(PSTR("NO COMMAND"), 0);
+		return;
+	}
+	//the indices behind it have moved, do not delete another command next time
+	current = UI_NO_COMMAND;
+}
 
-			if ((row == 0) && (col == 7) && (page == 1))
-			{
-				arr[i] = '7';
-				i++;
-			}
+static void run_browse()
+{
+	ir_source_t src;
+	char name[MAX_NAME_LEN];
+	char line[UI_TEXT_LEN];
 
-			if ((row == 0) && (col == 8) && (page == 1))
-			{
-				arr[i] = '8';
-				i++;
-			}
+	if (eeprom_open_command(current, &src) != EEPROM_OK)
+	{
+		lcdClear();
+		ui_message(PSTR("NO COMMAND"), 0);
+		return;
+	}
+	eeprom_get_command_name(current, name);
+	lcdWriteString(0, TWO_LINES_OFF, name);
+	strcpy_P(&line[fmt_dec(line, src.len)], PSTR(" EDGES"));
+	lcdWriteString(1, TWO_LINES_OFF, line);
+	ui_message(0, 0);
+}
 
-			if ((row == 0) && (col == 9) && (page == 1))
-			{
-				arr[i] = '9';
-				i++;
-			}
-		}
+static void run_settings()
+{
+	state = UI_SETTINGS;
+}
 
-		if (i >= 8)
-		{
-			goto end;
-		}
+static void draw()
+{
+	lcdClear();
+	lcdWriteString_P(0, TWO_LINES_OFF, items[item].title);
+	if (state == UI_SETTINGS) lcdWriteString_P(1, TWO_LINES_OFF, dump ? PSTR("IR DUMP: ON") : PSTR("IR DUMP: OFF"));
+}
 
+/** @brief Init UI/LCD
+ *
+ * This function initializes the SPI interface, the buttons
+ * and displays the welcome message.
+ */
+void ui_init()
+{
+	lcdSpiInit();	//starts the tick too
+	keys_init();
+	lcdInit();
+	lcdWriteString_P(0, 0, PSTR("WELCOME"));
+	lcdWriteString_P(1, 0, PSTR("(press S1)"));
+	lcdFlush();
+	message_task = sched_add(PSTR("uimsg"), ui_message_end, 0);
+	recorded_task = sched_add(PSTR("uirec"), ui_recorded, 0);
+	LOG(LOG_MOD_UI, LOG_INFO, "WELCOME");
+}
 
-		if (BUTTONPD2) //Mit S1 wird der Name bestätigt und ausgeprinted
-		{
-			end: arr[i++] = 0;
-			i = 0;
-			while (BUTTONPD2);
-			lcdClear();
-			uint8_t len = 0;
-			while (arr[len] != 0)
-			{
-				len++;
-			}
+/** @brief Step the UI state machine
+ *
+ * Called every UI_STEP_MS by the scheduler. Handles the queued button
+ * events and returns at once, only replay and delete block (see menu.h).
+ */
+void ui_step()
+{
+	uint8_t key = ui_press();
 
-			lcdSetCursor(0, 0);
-			for (i = 0; i < len; i++)
-			{
-				lcdSetCursor(0, i);
-				lcdWriteChar(arr[i]);
-				name[i] = arr[i];
-			}
+	switch (state)
+	{
+		case UI_MENU:
+			if (key == (KEYS_PRESS | KEY_S1))
+			{
+				if (++item >= UI_ITEMS) item = 0;
+				redraw = 1;
+			}
+			else if ((key == (KEYS_PRESS | KEY_S2)) && (item < UI_ITEMS))
+			{
+				if (pgm_read_byte(&items[item].pick)) browse_start();
+				else ui_run();		//the busy text is sent before the action starts
+			}
+			break;
+		case UI_BROWSE:
+			browse_key(key);
+			break;
+		case UI_RUN:
+			ui_menu();
+			((void (*)())pgm_read_word(&items[item].run))();
+			break;
+		case UI_RECORD:
+			record_step();
+			break;
+		case UI_NAME:
+			name_key(key);
+			break;
+		case UI_MESSAGE:
+			if (key != KEYS_NONE)
+			{
+				sched_stop(message_task);
+				ui_menu();
+			}
+			break;
+		case UI_SETTINGS:
+			if (key == (KEYS_PRESS | KEY_S2))
+			{
+				dump ^= 1;
+				redraw = 1;
+			}
+			else if (key == (KEYS_PRESS | KEY_S1)) ui_menu();
+			break;
+	}
 
-			uart_sendstring(name);
-			return 0;
-		}
+	if (redraw && (item < UI_ITEMS) && ((state == UI_MENU) || (state == UI_SETTINGS)))
+	{
+		redraw = 0;
+		draw();
 	}
+	lcdFlush();	//only the changed characters are sent
 }
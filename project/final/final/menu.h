@@ -1,9 +1,28 @@
 /*
- * ir.h
- * 
- * This module is responsible for the infrared record / replay
- * 
- * TBD: extend this file header with infos & name
+ * menu.h
+ *
+ * This module is responsible for the user interface (LCD, buttons S1..S4).
+ *
+ * The UI is a state machine stepped by ui_step() (a task, see sched.h),
+ * it never waits for a button, so the UART is serviced meanwhile:
+ *
+ *   menu      S1 selects the next item of the menu (a table in flash),
+ *             S2 runs the action of the item
+ *   run       the busy text of the item is shown, the action runs in the
+ *             next step (replay and delete block while the IR signal is
+ *             sent / the EEPROM is written)
+ *   record    the IR signal is captured by the ISRs, every step checks
+ *             for the result (ir_record_poll()), a recording is replayed
+ *             IR_RECORD_SETTLE_MS later (one shot task), then named
+ *   name      name input of a recorded command (character picker)
+ *   message   result of an action, shown until a button is pressed or
+ *             for UI_MESSAGE_MS
+ *   browse    stored commands, two per screen: S3/S4 select the
+ *             next/previous one, S2 runs the action with it, S1 goes
+ *             back to the menu (replay, delete and browse pick their
+ *             command here). Only the names of the visible page and of
+ *             the next one are loaded (eeprom_get_command_name()).
+ *   settings  S2 changes the setting, S1 goes back to the menu
  */
 
 #ifndef _MENU_H_
@@ -11,30 +30,24 @@
 
 #include "dogm_lcd.h"
 
+/** @brief How long a message stays on the LCD in ms */
+#define UI_MESSAGE_MS 3000
+
+/** @brief Period of ui_step() in ms */
+#define UI_STEP_MS 5
+
 /** @brief Init UI/LCD
  *
- * This function initializes the SPI interface
+ * This function initializes the SPI interface, the buttons
  * and displays the welcome message.
  */
 void ui_init();
-uint8_t name();
-uint8_t Alphabet(char *name);
 
-/** @brief Main UI/menu/LCD function
- * 
- * This function is called each time when the program requests user input
- * This function blocks as long as no command is selected.
- * 
- * When the function returns, the return value is a number for the
- * selected command. This number is used in main.c to do the corresponding
- * action (record/replay/delete).
- * 
- * @param index This pointer is set here to have an index value for main.c
- * @param ir_name This string is set here to a command name (for store)
- * @return Selected command
- * 
- * TBD: clearify the command return by using macros
+/** @brief Step the UI state machine
+ *
+ * Called every UI_STEP_MS by the scheduler. Handles the queued button
+ * events and returns at once, only replay and delete block (see above).
  */
-uint8_t ui_get_selection(uint8_t *index, char *ir_name);
+void ui_step();
 
 #endif /* _MENU_H_ */
@@ -0,0 +1,133 @@
+/*
+ * proto.c
+ *
+ * This module is responsible for the binary host protocol (see proto.h).
+ */
+
+#include "common.h"
+
+#define PROTO_IDEMPOTENT 0x01	///< a repeated request is executed again
+#define PROTO_REPLAY 0x02		///< handled during a stream replay (short, no storage access)
+
+typedef struct
+{
+	uint8_t type;
+	uint8_t flags;
+	proto_handler_t run;
+} proto_cmd_t;
+
+static uint8_t last_seq;
+static uint8_t last_valid = 0;
+
+static void send(uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t len)
+{
+	uint8_t out[FRAME_MAX_ENCODED + 1];
+
+	uart_write(out, frame_pack(type, seq, payload, len, out));
+}
+
+static uint8_t cmd_ping(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	memcpy(reply, payload, len);
+	*reply_len = len;
+	return 0;
+}
+
+static uint8_t cmd_info(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	uint32_t baud = UART_BAUD;
+
+	reply[0] = PROTO_VERSION;
+	reply[1] = FRAME_MAX_PAYLOAD;
+	reply[2] = STORAGE_SIZE & 0xFF;
+	reply[3] = (uint16_t)STORAGE_SIZE >> 8;
+	for(uint8_t i = 0; i < 4; i++) reply[4 + i] = baud >> (8 * i);
+	*reply_len = 8;
+	return 0;
+}
+
+static uint8_t cmd_close(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	return 0;
+}
+
+static const proto_cmd_t commands[] PROGMEM =
+{
+	{ FRAME_PING, PROTO_IDEMPOTENT, cmd_ping },
+	{ FRAME_INFO, PROTO_IDEMPOTENT, cmd_info },
+	{ FRAME_CLOSE, PROTO_IDEMPOTENT, cmd_close },
+	{ FRAME_LIB_INFO, PROTO_IDEMPOTENT, xfer_lib_info },
+	{ FRAME_READ, PROTO_IDEMPOTENT, xfer_read },
+	{ FRAME_IMPORT_BEGIN, 0, xfer_import_begin },
+	{ FRAME_IMPORT_DATA, PROTO_IDEMPOTENT, xfer_import_data },
+	{ FRAME_IMPORT_END, PROTO_IDEMPOTENT, xfer_import_end },
+	{ FRAME_STREAM_BEGIN, PROTO_IDEMPOTENT, stream_begin },
+	{ FRAME_STREAM_DATA, PROTO_IDEMPOTENT | PROTO_REPLAY, stream_data },
+	{ FRAME_STREAM_END, PROTO_IDEMPOTENT | PROTO_REPLAY, stream_end },
+	{ FRAME_STREAM_STATUS, PROTO_IDEMPOTENT | PROTO_REPLAY, stream_status },
+	{ FRAME_SNIFF_START, PROTO_IDEMPOTENT, sniff_req_start },
+	{ FRAME_SNIFF_READ, 0, sniff_req_read },
+	{ FRAME_SNIFF_STOP, PROTO_IDEMPOTENT, sniff_req_stop },
+};
+
+void proto_poll()
+{
+	uint8_t buf[UART_FRAME_LEN];
+	uint8_t reply[FRAME_MAX_PAYLOAD];
+	uint8_t reply_len = 0;
+	uint8_t len = uart_getframe(buf);
+	const proto_cmd_t *cmd = 0;
+	proto_handler_t run;
+	uint8_t type, seq, nak, flags;
+	int16_t n;
+
+	if(len == 0) return;
+	n = frame_unpack(buf, len);
+	if(n < 0)
+	{
+		//seq may be broken as well, the host retransmits anyway
+		nak = FRAME_NAK_CRC;
+		send(FRAME_NAK, (len >= 2) ? buf[1] : 0, &nak, 1);
+		return;
+	}
+	type = buf[0];
+	seq = buf[1];
+
+	for(uint8_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+	{
+		if(pgm_read_byte(&commands[i].type) == type) cmd = &commands[i];
+	}
+	if(cmd == 0)
+	{
+		nak = FRAME_NAK_TYPE;
+		send(FRAME_NAK, seq, &nak, 1);
+		return;
+	}
+	flags = pgm_read_byte(&cmd->flags);
+	run = (proto_handler_t)pgm_read_word(&cmd->run);
+	//called between the edges of a stream replay: a longer handler would
+	//stretch the current edge
+	if(stream_playing() && !(flags & PROTO_REPLAY))
+	{
+		nak = FRAME_NAK_STATE;
+		send(FRAME_NAK, seq, &nak, 1);
+		return;
+	}
+	//retransmission of a request which was executed already (ACK lost)
+	if(last_valid && (seq == last_seq) && !(flags & PROTO_IDEMPOTENT))
+	{
+		send(FRAME_ACK, seq, 0, 0);
+		return;
+	}
+
+	nak = run(&buf[2], n, reply, &reply_len);
+	if(nak)
+	{
+		send(FRAME_NAK, seq, &nak, 1);
+		return;
+	}
+	last_seq = seq;
+	last_valid = 1;
+	send(FRAME_ACK, seq, reply, reply_len);
+	if(type == FRAME_CLOSE) uart_frame_mode(0);
+}
@@ -0,0 +1,44 @@
+/*
+ * proto.h
+ *
+ * This module is responsible for the binary host protocol.
+ *
+ * The host switches the UART to binary frames by sending 0x00 (see
+ * uart_frame_mode()) and sends requests as frames (frame.h). Every
+ * request is answered by a FRAME_ACK or FRAME_NAK frame with the seq of
+ * the request. The host sends the next request after the answer
+ * (stop and wait), a request without answer is sent again with the same
+ * seq. A repeated seq is not executed twice (unless the request is
+ * idempotent), it is only acknowledged again.
+ *
+ * While a stream is replayed (see stream.h), only FRAME_STREAM_DATA,
+ * FRAME_STREAM_END and FRAME_STREAM_STATUS are handled, the other
+ * requests are rejected with FRAME_NAK_STATE.
+ *
+ * FRAME_INFO ACK payload:
+ *   PROTO_VERSION (1B) | FRAME_MAX_PAYLOAD (1B) | STORAGE_SIZE (2B) | UART_BAUD (4B)
+ * (multi byte values little endian)
+ */
+
+#ifndef _PROTO_H_
+#define _PROTO_H_
+
+#define PROTO_VERSION 1
+
+/** @brief Handler of a request type
+ *
+ * @param payload Payload of the request
+ * @param len Payload size
+ * @param reply (out) -> Payload of the ACK (FRAME_MAX_PAYLOAD bytes)
+ * @param reply_len (out) -> Size of the ACK payload (0 when called)
+ * @return 0: send ACK, FRAME_NAK_*: send NAK with this reason
+ */
+typedef uint8_t (*proto_handler_t)(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len);
+
+/** @brief Handle a received frame (non-blocking if there is none)
+ *
+ * Called from the main loop as soon as uart_frame_ready() is set.
+ */
+void proto_poll();
+
+#endif /* _PROTO_H_ */
@@ -0,0 +1,155 @@
+/*
+ * sched.c
+ *
+ * This module is responsible for running the tasks of the main loop
+ * (see sched.h).
+ */
+
+#include "common.h"
+#include <avr/sleep.h>
+
+typedef struct
+{
+	const char *name;
+	void (*run)();
+	uint16_t period;			//0: one shot
+	uint16_t due;				//tick_ms() of the next run
+	uint8_t active;
+	uint16_t runs;
+	volatile uint16_t ms;		//charged by the tick
+	uint16_t max;
+} task_t;
+
+static task_t tasks[SCHED_MAX_TASKS];
+static uint8_t count = 0;
+static volatile uint8_t running = SCHED_NONE;
+static volatile uint16_t idle_ms = 0;
+
+/** @brief Add a task
+ *
+ * A periodic task runs the first time in the next pass of sched_run(),
+ * a one shot task (period 0) when it is started with sched_start().
+ *
+ * @param name Name (in flash, PSTR()) for the statistics
+ * @param run Task function
+ * @param period Period in ms, 0: one shot
+ * @return Task id, SCHED_NONE if SCHED_MAX_TASKS are added already
+ */
+uint8_t sched_add(const char *name, void (*run)(), uint16_t period)
+{
+	task_t *t;
+
+	if(count >= SCHED_MAX_TASKS) return SCHED_NONE;
+	t = &tasks[count];
+	memset(t, 0, sizeof(task_t));
+	t->name = name;
+	t->run = run;
+	t->period = period;
+	t->due = tick_ms();
+	t->active = (period != 0);
+	return count++;
+}
+
+/** @brief (Re)start a task
+ *
+ * @param id Task id
+ * @param delay ms until the next run
+ */
+void sched_start(uint8_t id, uint16_t delay)
+{
+	if(id >= count) return;
+	tasks[id].due = tick_ms() + delay;
+	tasks[id].active = 1;
+}
+
+/** @brief Stop a task, it does not run until it is started again
+ * @param id Task id
+ */
+void sched_stop(uint8_t id)
+{
+	if(id < count) tasks[id].active = 0;
+}
+
+/** @brief Run the due tasks, sleep when none is due (never returns) */
+void sched_run()
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	while(1)
+	{
+		uint8_t ran = 0;
+
+		for(uint8_t id = 0; id < count; id++)
+		{
+			task_t *t = &tasks[id];
+			uint16_t start = tick_ms();
+			uint16_t took;
+
+			if(!t->active || ((int16_t)(start - t->due) < 0)) continue;
+			if(t->period == 0) t->active = 0;
+			else
+			{
+				t->due += t->period;
+				//too late for the next run too: skip, no burst of catch up runs
+				if((int16_t)(start - t->due) >= 0) t->due = start + t->period;
+			}
+
+			running = id;
+			t->run();
+			running = SCHED_NONE;
+
+			took = tick_ms() - start;
+			if(took > t->max) t->max = took;
+			t->runs++;
+			ran = 1;
+		}
+		//the tick wakes up every 0.5 ms
+		if(!ran) sleep_mode();
+	}
+}
+
+/** @brief Fetch the statistics of a task and reset them
+ *
+ * @param id Task id
+ * @param stats (out) -> Statistics since the last call
+ * @return 1 on success, 0 if there is no task with this id
+ */
+uint8_t sched_get_stats(uint8_t id, sched_stats_t *stats)
+{
+	task_t *t;
+
+	if(id >= count) return 0;
+	t = &tasks[id];
+	stats->name = t->name;
+	stats->runs = t->runs;
+	stats->max = t->max;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		stats->ms = t->ms;
+		t->ms = 0;
+	}
+	t->runs = 0;
+	t->max = 0;
+	return 1;
+}
+
+/** @brief Idle time and reset it
+ * @return ms without a running task since the last call
+ */
+uint16_t sched_get_idle()
+{
+	uint16_t ms;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		ms = idle_ms;
+		idle_ms = 0;
+	}
+	return ms;
+}
+
+/** @brief Tick hook, called every ms from the tick interrupt */
+void sched_tick()
+{
+	if(running < count) tasks[running].ms++;
+	else idle_ms++;
+}
@@ -0,0 +1,79 @@
+/*
+ * sched.h
+ *
+ * This module is responsible for running the tasks of the main loop
+ * (cooperative scheduler on the millisecond tick, see tick.h).
+ *
+ * A task is a function which does a piece of work and returns. It is
+ * either periodic (every period ms) or a one shot, which runs once after
+ * the delay given to sched_start(), e.g. the end of a message on the LCD.
+ * Nothing waits with _delay_ms(): a task that has nothing to do returns,
+ * when no task is due the CPU sleeps until the next interrupt.
+ *
+ * The run time of the tasks is accounted: the millisecond tick charges
+ * the task which is running (or idle), so the ms add up to the elapsed
+ * time. The CLI command "tasks" lists them (see cli.h).
+ */
+
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+/** @brief Max number of tasks */
+#define SCHED_MAX_TASKS 8
+
+/** @brief No task (sched_add() failed / no task running) */
+#define SCHED_NONE 0xFF
+
+/** @brief Run time statistics of a task */
+typedef struct
+{
+	const char *name;	///< in flash
+	uint16_t runs;		///< number of runs
+	uint16_t ms;		///< time spent in the task in ms
+	uint16_t max;		///< longest run in ms (0: below 1 ms)
+} sched_stats_t;
+
+/** @brief Add a task
+ *
+ * A periodic task runs the first time in the next pass of sched_run(),
+ * a one shot task (period 0) when it is started with sched_start().
+ *
+ * @param name Name (in flash, PSTR()) for the statistics
+ * @param run Task function
+ * @param period Period in ms, 0: one shot
+ * @return Task id, SCHED_NONE if SCHED_MAX_TASKS are added already
+ */
+uint8_t sched_add(const char *name, void (*run)(), uint16_t period);
+
+/** @brief (Re)start a task
+ *
+ * @param id Task id
+ * @param delay ms until the next run
+ */
+void sched_start(uint8_t id, uint16_t delay);
+
+/** @brief Stop a task, it does not run until it is started again
+ * @param id Task id
+ */
+void sched_stop(uint8_t id);
+
+/** @brief Run the due tasks, sleep when none is due (never returns) */
+void sched_run();
+
+/** @brief Fetch the statistics of a task and reset them
+ *
+ * @param id Task id
+ * @param stats (out) -> Statistics since the last call
+ * @return 1 on success, 0 if there is no task with this id
+ */
+uint8_t sched_get_stats(uint8_t id, sched_stats_t *stats);
+
+/** @brief Idle time and reset it
+ * @return ms without a running task since the last call
+ */
+uint16_t sched_get_idle();
+
+/** @brief Tick hook, called every ms from the tick interrupt */
+void sched_tick();
+
+#endif /* _SCHED_H_ */
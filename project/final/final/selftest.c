@@ -0,0 +1,122 @@
+/*
+ * selftest.c
+ *
+ * This module is responsible for the storage self test (see selftest.h).
+ */
+
+#include "common.h"
+#include <avr/sleep.h>
+
+#ifdef SELFTEST
+
+/// size of the test commands: big enough that EEPROM_MAX_COMMANDS of them
+/// do not fit into the memory (the test fills it), at least a NEC frame
+#define TEST_EDGES_FILL ((STORAGE_SIZE / EEPROM_MAX_COMMANDS - EEPROM_REC_HEADER_SIZE) / 2 + 1)
+#if TEST_EDGES_FILL > MAX_IR_EDGES - 1
+#define TEST_EDGES (MAX_IR_EDGES - 1)
+#elif TEST_EDGES_FILL < NEC_EDGES
+#define TEST_EDGES NEC_EDGES
+#else
+#define TEST_EDGES TEST_EDGES_FILL
+#endif
+
+/// timings of test command k
+static void pattern(uint8_t k, uint16_t *ir, uint8_t edges)
+{
+	for(uint8_t i = 0; i < edges; i++) ir[i] = 100 + 7 * k + i;
+	ir[edges] = 1;
+}
+
+/// name of test command k ("t00042")
+static void pattern_name(uint8_t k, char *name)
+{
+	name[0] = 't';
+	fmt_dec_width(&name[1], k, FMT_DEC_LEN, '0');
+}
+
+/// load command with the name of k and compare with the pattern
+static uint8_t check(uint8_t k, uint8_t edges)
+{
+	char name[MAX_NAME_LEN];
+	int8_t index;
+
+	pattern_name(k, name);
+	index = eeprom_get_command_index(name);
+	if(index < 0) return 1;
+	if(eeprom_load_command(index, ir_timings) != EEPROM_OK) return 1;
+	for(uint8_t i = 0; i < edges; i++)
+	{
+		if(ir_timings[i] != 100 + 7 * k + i) return 1;
+	}
+	return (ir_timings[edges] == 1) ? 0 : 1;
+}
+
+/// report (step in flash) and stop
+static void result(const char *step, uint8_t stored)
+{
+	char num[FMT_DEC_LEN + 1];
+
+	uart_sendstring_P(PSTR("\r\nSELFTEST "));
+	uart_sendstring_P(step);
+	uart_sendstring_P(PSTR(" commands="));
+	fmt_dec(num, stored);
+	uart_sendstring(num);
+	uart_sendstring_P(PSTR(" bytes="));
+	fmt_dec(num, STORAGE_SIZE);
+	uart_sendstring(num);
+	uart_sendstring_P(PSTR("\r\n"));
+
+	uart_flush();
+	cli();
+	sleep_mode();
+}
+
+void selftest_run()
+{
+	const uint8_t edges = TEST_EDGES;
+	char name[MAX_NAME_LEN];
+	uint8_t stored = 0;
+	uint8_t k;
+
+	eeprom_init();
+	while(eeprom_get_command_count()) eeprom_delete_command(0);
+	if(eeprom_get_command_count() != 0) result(PSTR("FAIL delete"), 0);
+
+	//fill until full
+	for(k = 0; k < EEPROM_MAX_COMMANDS; k++)
+	{
+		pattern(k, ir_timings, edges);
+		pattern_name(k, name);
+		if(eeprom_store_command(-1, name, ir_timings) != EEPROM_OK) break;
+		stored++;
+	}
+	if((stored == 0) || (eeprom_get_command_count() != stored)) result(PSTR("FAIL store"), stored);
+	for(k = 0; k < stored; k++)
+	{
+		if(check(k, edges)) result(PSTR("FAIL load"), k);
+	}
+
+	//re-init must find the same library
+	if((eeprom_init() != EEPROM_OK) || (eeprom_get_command_count() != stored)) result(PSTR("FAIL init"), stored);
+
+	//delete every second command, refill -> compaction
+	for(k = 0; k < stored; k += 2)
+	{
+		pattern_name(k, name);
+		if(eeprom_delete_command(eeprom_get_command_index(name)) != EEPROM_OK) result(PSTR("FAIL delete"), k);
+	}
+	for(k = 0; k < stored; k += 2)
+	{
+		pattern(k, ir_timings, edges);
+		pattern_name(k, name);
+		if(eeprom_store_command(-1, name, ir_timings) != EEPROM_OK) result(PSTR("FAIL compact"), k);
+	}
+	for(k = 0; k < stored; k++)
+	{
+		if(check(k, edges)) result(PSTR("FAIL reload"), k);
+	}
+
+	result(PSTR("PASS"), stored);
+}
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ * selftest.h
+ *
+ * This module is responsible for the storage self test.
+ *
+ * Only compiled with -DSELFTEST (make selftest), it runs instead of the
+ * normal firmware, e.g. in simavr to verify a storage backend.
+ */
+
+#ifndef _SELFTEST_H_
+#define _SELFTEST_H_
+
+/** @brief Run the storage self test
+ *
+ * Fills the command library until it is full, checks every command,
+ * deletes every second one and fills it again (compaction).
+ * The result is sent via UART ("SELFTEST PASS"/"SELFTEST FAIL"),
+ * afterwards the CPU is stopped (simavr exits).
+ *
+ * @warning All stored commands are deleted!
+ */
+void selftest_run();
+
+#endif /* _SELFTEST_H_ */
@@ -0,0 +1,158 @@
+/*
+ * sniff.c
+ *
+ * This module is responsible for the IR sniffer (see sniff.h).
+ *
+ * The ring is written by the capture ISR only (head) and read by the
+ * request handlers only (tail), the UART is never touched in the ISR.
+ */
+
+#include "common.h"
+
+#define RING_MASK (SNIFF_RING_SIZE - 1)
+#define INDEX_MASK (2 * SNIFF_RING_SIZE - 1)
+#define TICKS_MAX 0x7FFFFFFFUL
+
+static volatile uint32_t ring[SNIFF_RING_SIZE];
+static volatile uint8_t head = 0;		///< next write position (ISR)
+static volatile uint8_t tail = 0;		///< next read position
+static volatile uint16_t overruns = 0;
+static volatile uint8_t active = 0;		///< 0: off, otherwise mode + 1
+static volatile uint16_t ovf = 0;		///< Timer1 overflows: high word of the timestamp
+static uint32_t last;					///< timestamp of the last edge
+static uint8_t started;					///< last is valid
+
+static uint8_t ring_used()
+{
+	return (head - tail) & INDEX_MASK;
+}
+
+/** @brief Start the sniffer (Timer1 free running with input capture)
+ *
+ * @param mode SNIFF_RAW or SNIFF_EVENTS
+ */
+void sniff_start(uint8_t mode)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		DDRB &= ~(1<<PB0);						//input capture pin, pullup
+		PORTB |= (1<<PB0);
+		TCCR1A = 0;
+		TCCR1B = (1<<CS11) | (1<<CS10);			//prescaler 64 -> 4 us, falling edge
+		TCNT1 = 0;
+		TIFR1 = (1<<ICF1) | (1<<TOV1);
+		head = tail = 0;
+		overruns = 0;
+		ovf = 0;
+		started = 0;
+		irdec_reset();
+		active = mode + 1;
+		TIMSK1 |= (1<<ICIE1) | (1<<TOIE1);
+	}
+}
+
+/** @brief Stop the sniffer, Timer1 is free for recording again */
+void sniff_stop()
+{
+	TIMSK1 &= ~((1<<ICIE1) | (1<<TOIE1));
+	active = 0;
+}
+
+/** @brief Capture hook of the Timer1 input capture ISR
+ *
+ * @return 1 if the capture was taken by the sniffer, 0 if it is not active
+ */
+uint8_t sniff_capture()
+{
+	uint16_t icr = ICR1;
+	uint16_t hi = ovf;
+	uint8_t mark;
+	uint32_t stamp, ticks;
+
+	if(!active) return 0;
+	//the input is active low: a rising edge ends a mark
+	mark = (TCCR1B & (1<<ICES1)) ? 1 : 0;
+	TCCR1B ^= (1<<ICES1);
+	TIFR1 = (1<<ICF1);							//changing the edge may set the flag
+	//overflow not handled yet, but before the capture
+	if((TIFR1 & (1<<TOV1)) && (icr < 0x8000)) hi++;
+	stamp = ((uint32_t)hi << 16) | icr;
+
+	if(started)
+	{
+		ticks = stamp - last;
+		if(ticks > TICKS_MAX) ticks = TICKS_MAX;
+		if(active == SNIFF_EVENTS + 1) irdec_feed(ticks, mark, stamp);
+		else if(ring_used() < SNIFF_RING_SIZE)
+		{
+			ring[head & RING_MASK] = (ticks << 1) | mark;
+			head = (head + 1) & INDEX_MASK;
+		}
+		else overruns++;
+	}
+	last = stamp;
+	started = 1;
+	return 1;
+}
+
+ISR(TIMER1_OVF_vect)
+{
+	ovf++;
+}
+
+static uint8_t varint(uint32_t val, uint8_t *out)
+{
+	uint8_t n = 0;
+
+	while(val >= 0x80)
+	{
+		out[n++] = (val & 0x7F) | 0x80;
+		val >>= 7;
+	}
+	out[n++] = val;
+	return n;
+}
+
+/** @brief FRAME_SNIFF_START: start capturing */
+uint8_t sniff_req_start(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	uint8_t mode = len ? payload[0] : SNIFF_RAW;
+
+	if(mode > SNIFF_EVENTS) return FRAME_NAK_LENGTH;
+	if(ir_recording()) return FRAME_NAK_STATE;	//Timer1 is in use
+	sniff_start(mode);
+	return 0;
+}
+
+/** @brief FRAME_SNIFF_READ: remove the consumed intervals, reply the next ones */
+uint8_t sniff_req_read(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	uint8_t used = ring_used();
+	uint8_t count = 0;
+	uint8_t n = 3;
+	uint16_t o;
+
+	if(len != 1) return FRAME_NAK_LENGTH;
+	if(payload[0] > used) return FRAME_NAK_STATE;
+	tail = (tail + payload[0]) & INDEX_MASK;
+	used -= payload[0];
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE){ o = overruns; }
+	reply[0] = o & 0xFF;
+	reply[1] = o >> 8;
+	while((count < used) && (n + SNIFF_VARINT_MAX <= FRAME_MAX_PAYLOAD))
+	{
+		n += varint(ring[(tail + count) & RING_MASK], &reply[n]);
+		count++;
+	}
+	reply[2] = count;
+	*reply_len = n;
+	return 0;
+}
+
+/** @brief FRAME_SNIFF_STOP: stop capturing */
+uint8_t sniff_req_stop(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	sniff_stop();
+	return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * sniff.h
+ *
+ * This module is responsible for the IR sniffer: every interval captured
+ * by Timer1 (input capture, 4 us resolution) is streamed to the host,
+ * without end, e.g. to log remote traffic for hours (tools/irlink sniff).
+ *
+ * The capture ISR only stores the intervals in a ring of SNIFF_RING_SIZE
+ * entries, the host fetches them with the binary protocol (see proto.h):
+ *
+ *   FRAME_SNIFF_START  [mode (1B)] -> ACK
+ *   FRAME_SNIFF_READ   consumed (1B) -> ACK: overruns (2B) | count (1B) | intervals
+ *   FRAME_SNIFF_STOP   -> ACK
+ *
+ * consumed is the count of the last reply received by the host, these
+ * intervals are removed from the ring. The reply contains the next count
+ * intervals (they stay in the ring until they are consumed, a lost reply
+ * costs no intervals). An empty ACK payload is the answer to a repeated
+ * request (see proto.h), the host requests again with consumed 0.
+ *
+ * Every interval is a varint (LEB128: 7 bits per byte, LSB first, bit 7
+ * set if another byte follows) of (ticks << 1) | mark, ticks in 4 us
+ * (max. 2^31 - 1), mark is 1 for a mark and 0 for a space. Intervals are
+ * measured between free running timestamps, so a lost interval does not
+ * shift the following ones.
+ *
+ * overruns counts the intervals lost because the ring was full (since
+ * FRAME_SNIFF_START, 16 bit wrapping).
+ *
+ * mode SNIFF_EVENTS (default SNIFF_RAW) does not queue the intervals but
+ * decodes them right away and sends key events (see irdec.h).
+ */
+
+#ifndef _SNIFF_H_
+#define _SNIFF_H_
+
+/** @brief Number of intervals buffered between two reads (power of 2, max. 128) */
+#define SNIFF_RING_SIZE 32
+/** @brief Resolution of the intervals in us */
+#define SNIFF_TICK_US 4
+/** @brief Max size of one varint interval */
+#define SNIFF_VARINT_MAX 5
+
+/** @brief Sniffer modes */
+#define SNIFF_RAW 0			///< intervals are queued for FRAME_SNIFF_READ
+#define SNIFF_EVENTS 1		///< intervals are decoded, see irdec.h
+
+/** @brief Start the sniffer (Timer1 free running with input capture)
+ *
+ * @param mode SNIFF_RAW or SNIFF_EVENTS
+ */
+void sniff_start(uint8_t mode);
+
+/** @brief Stop the sniffer, Timer1 is free for recording again */
+void sniff_stop();
+
+/** @brief Capture hook of the Timer1 input capture ISR
+ *
+ * @return 1 if the capture was taken by the sniffer, 0 if it is not active
+ */
+uint8_t sniff_capture();
+
+/** @brief FRAME_SNIFF_START: start capturing */
+uint8_t sniff_req_start(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len);
+
+/** @brief FRAME_SNIFF_READ: remove the consumed intervals, reply the next ones */
+uint8_t sniff_req_read(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len);
+
+/** @brief FRAME_SNIFF_STOP: stop capturing */
+uint8_t sniff_req_stop(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len);
+
+#endif /* _SNIFF_H_ */
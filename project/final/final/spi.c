@@ -0,0 +1,57 @@
+/*
+ * spi.c
+ *
+ * This module is responsible for the shared SPI bus (see spi.h).
+ */
+
+#include "common.h"
+
+/// clock per device: SPR1:0 bits for SPCR, SPI2X bit for SPSR
+static const uint8_t spi_spcr[] = {
+	0,
+	LCD_SPCR_BITS,	//LCD: fosc/LCD_SPI_DIV (see dogm_lcd.h)
+	0,				//flash: fosc/2 (with SPI2X)
+};
+static const uint8_t spi_spsr[] = { 0, LCD_SPSR_BITS, (1<<SPI2X) };
+
+static volatile uint8_t spi_owner = SPI_OWNER_NONE;
+
+void spi_init()
+{
+	PORTB |= (1 << PB2);								// LCD unselected
+	DDRB |= (1 << DDB3) | (1 << DDB5) | (1 << DDB2);	// MOSI, SS, SCK output
+	DDRB &= ~(1 << DDB4);								// MISO input
+	SPCR = (1<<SPE) | (1<<MSTR) | (1<<CPOL) | (1<<CPHA);
+}
+
+uint8_t spi_acquire(uint8_t owner)
+{
+	uint8_t ok = 0;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if((spi_owner == SPI_OWNER_NONE) || (spi_owner == owner))
+		{
+			spi_owner = owner;
+			ok = 1;
+		}
+	}
+	if(ok)
+	{
+		SPCR = (SPCR & ~((1<<SPR1) | (1<<SPR0))) | spi_spcr[owner];
+		SPSR = spi_spsr[owner];
+	}
+	return ok;
+}
+
+void spi_release(uint8_t owner)
+{
+	if(spi_owner == owner) spi_owner = SPI_OWNER_NONE;
+}
+
+uint8_t spi_transfer(uint8_t data)
+{
+	SPDR = data;
+	while(!(SPSR & (1 << SPIF)));
+	return SPDR;
+}
@@ -0,0 +1,50 @@
+/*
+ * spi.h
+ *
+ * This module is responsible for the SPI bus, which is shared by the
+ * LCD (dogm_lcd.c, SS = PB2) and the external flash
+ * (storage_spiflash.c, CS = PC0).
+ *
+ * A device must own the bus for a transfer (spi_acquire() /
+ * spi_release()). Acquiring the bus also switches to the SPI clock of
+ * this device. All devices use SPI mode 3.
+ */
+
+#ifndef _SPI_H_
+#define _SPI_H_
+
+#include <avr/io.h>
+
+/** @brief Devices on the SPI bus */
+#define SPI_OWNER_NONE 0
+#define SPI_OWNER_LCD 1
+#define SPI_OWNER_FLASH 2
+
+/** @brief Init the SPI interface (master, mode 3)
+ *
+ * Sets SS (LCD) high, so the LCD ignores transfers to other devices.
+ * Calling it more than once is harmless.
+ */
+void spi_init();
+
+/** @brief Get the bus for a device
+ *
+ * @param owner SPI_OWNER_LCD or SPI_OWNER_FLASH
+ * @return 1 if the bus belongs to owner now, 0 if it is used by another device
+ */
+uint8_t spi_acquire(uint8_t owner);
+
+/** @brief Release the bus
+ *
+ * @param owner Device which owns the bus
+ */
+void spi_release(uint8_t owner);
+
+/** @brief Transfer one byte (blocking)
+ *
+ * @param data Byte to send
+ * @return Received byte
+ */
+uint8_t spi_transfer(uint8_t data);
+
+#endif /* _SPI_H_ */
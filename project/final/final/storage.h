@@ -0,0 +1,107 @@
+/*
+ * storage.h
+ *
+ * This module is the memory backend of the command library (eeprom.c).
+ *
+ * The backend is selected at compile time with STORAGE in the Makefile
+ * (-D STORAGE_BACKEND=STORAGE_...):
+ *
+ *   STORAGE_EEPROM  internal EEPROM (1 KB), storage_eeprom.c
+ *   STORAGE_FLASH   reserved region of the application flash (15 KB),
+ *                   written by an SPM routine in the boot section,
+ *                   storage_flash.c
+ *   STORAGE_SPIFLASH external W25Qxx SPI NOR flash (first 60 KB), CS on PC0,
+ *                   shares the SPI bus with the LCD, storage_spiflash.c
+ *   STORAGE_I2C     external 24LC256 I2C EEPROM (32 KB) at address 0x50,
+ *                   SDA PC4 / SCL PC5, storage_i2c.c
+ *
+ * All backends look like a byte addressable memory of STORAGE_SIZE bytes.
+ * Writes may be buffered by the backend, storage_flush() commits them.
+ *
+ * STORAGE_ERASE_SIZE is the unit of storage_discard() (SPI flash: one
+ * sector), the backends without an erase use the whole memory.
+ */
+
+#ifndef _STORAGE_H_
+#define _STORAGE_H_
+
+#define STORAGE_EEPROM 0
+#define STORAGE_FLASH 1
+#define STORAGE_SPIFLASH 2
+#define STORAGE_I2C 3
+
+#ifndef STORAGE_BACKEND
+#define STORAGE_BACKEND STORAGE_EEPROM
+#endif
+
+#if STORAGE_BACKEND == STORAGE_EEPROM
+#define STORAGE_SIZE (E2END + 1)
+#define STORAGE_ERASE_SIZE STORAGE_SIZE
+#elif STORAGE_BACKEND == STORAGE_FLASH
+/** @brief Flash region of the command library
+ *
+ * The firmware (.text) must end below FLASH_STORE_START, the SPM routine
+ * is placed at FLASH_STORE_END (start of a 1 KB boot section, BOOTSZ=10).
+ * Both addresses are set in the Makefile (compiler and linker).
+ */
+#ifndef FLASH_STORE_START
+#define FLASH_STORE_START 0x4000
+#endif
+#ifndef FLASH_STORE_END
+#define FLASH_STORE_END 0x7C00
+#endif
+#define STORAGE_SIZE (FLASH_STORE_END - FLASH_STORE_START)
+#define STORAGE_ERASE_SIZE STORAGE_SIZE
+#elif STORAGE_BACKEND == STORAGE_SPIFLASH
+/// 15 sectors of 4 KB (addresses stay 16 bit), sectors 16/17: spare sector and its tag
+#define STORAGE_SIZE 0xF000
+#define STORAGE_ERASE_SIZE 4096
+#elif STORAGE_BACKEND == STORAGE_I2C
+#define STORAGE_SIZE 0x8000
+#define STORAGE_ERASE_SIZE STORAGE_SIZE
+#else
+#error "unknown STORAGE_BACKEND"
+#endif
+
+/** @brief Init the storage backend
+ *
+ * @return 0 on success, 1 if the memory does not respond
+ */
+uint8_t storage_init();
+
+/** @brief Read bytes from the storage
+ *
+ * @param addr Start address (0 ... STORAGE_SIZE - 1)
+ * @param buf (out) -> Destination
+ * @param len Number of bytes
+ */
+void storage_read(uint16_t addr, void *buf, uint16_t len);
+
+/** @brief Write bytes to the storage
+ *
+ * The data may stay in a buffer of the backend until the next
+ * storage_flush() (or until a write to another page).
+ *
+ * @param addr Start address (0 ... STORAGE_SIZE - 1)
+ * @param buf Source
+ * @param len Number of bytes
+ */
+void storage_write(uint16_t addr, const void *buf, uint16_t len);
+
+/** @brief Commit all buffered writes */
+void storage_flush();
+
+/** @brief Announce that a range will be completely rewritten
+ *
+ * The old content of the range may be discarded (it is undefined until
+ * written). A backend which cannot overwrite data cheaply prepares the
+ * range here (SPI flash: sectors are erased), the others do nothing.
+ * Only units of STORAGE_ERASE_SIZE bytes completely inside the range
+ * are discarded. An SPI flash sector erase blocks for up to 400 ms.
+ *
+ * @param addr Start address
+ * @param len Number of bytes
+ */
+void storage_discard(uint16_t addr, uint16_t len);
+
+#endif /* _STORAGE_H_ */
@@ -0,0 +1,36 @@
+/*
+ * storage_eeprom.c
+ *
+ * Storage backend: internal EEPROM (see storage.h).
+ */
+
+#include "common.h"
+
+#if STORAGE_BACKEND == STORAGE_EEPROM
+
+uint8_t storage_init()
+{
+	return 0;
+}
+
+void storage_read(uint16_t addr, void *buf, uint16_t len)
+{
+	eeprom_read_block(buf, (const void *)addr, len);
+}
+
+//only changed bytes are written (saves erase/write cycles)
+void storage_write(uint16_t addr, const void *buf, uint16_t len)
+{
+	eeprom_update_block(buf, (void *)addr, len);
+}
+
+void storage_flush()
+{
+}
+
+//bytes are overwritten directly
+void storage_discard(uint16_t addr, uint16_t len)
+{
+}
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * storage_flash.c
+ *
+ * Storage backend: reserved region of the application flash
+ * (FLASH_STORE_START ... FLASH_STORE_END, see storage.h).
+ *
+ * Flash can only be written page wise (SPM_PAGESIZE bytes, erase + write).
+ * Writes are collected in a page buffer in SRAM, the page is programmed
+ * when a write hits another page or on storage_flush(). So a record
+ * written in several small steps costs one erase/write cycle per page.
+ *
+ * SPM instructions only work from the boot section: flash_program_page()
+ * is linked to .bootloader (FLASH_STORE_END). This needs BOOTSZ=10
+ * (1 KB boot section) and BOOTRST unprogrammed, i.e. flashing with an ISP
+ * programmer instead of the Arduino bootloader.
+ */
+
+#include "common.h"
+#include <avr/boot.h>
+
+#if STORAGE_BACKEND == STORAGE_FLASH
+
+/// the region itself, the linker places it at FLASH_STORE_START and
+/// complains if the firmware grows into it
+const uint8_t flash_store[STORAGE_SIZE] __attribute__((section(".flashstore"), used)) = { 0 };
+
+static uint8_t page_buf[SPM_PAGESIZE];
+static uint16_t page_addr;			///< storage address of the buffered page
+static uint8_t page_valid = 0;
+static uint8_t page_dirty = 0;
+
+/* Erase and program one flash page (runs from the boot section).
+ * Interrupts are off during programming, the vector table is in the
+ * RWW section and not readable meanwhile.
+ */
+static void flash_program_page(uint16_t page, const uint8_t *buf)
+	__attribute__((section(".bootloader"), noinline));
+
+static void flash_program_page(uint16_t page, const uint8_t *buf)
+{
+	uint8_t sreg = SREG;
+
+	cli();
+	eeprom_busy_wait();
+	boot_page_erase(page);
+	boot_spm_busy_wait();
+	for(uint16_t i = 0; i < SPM_PAGESIZE; i += 2)
+	{
+		boot_page_fill(page + i, buf[i] | (buf[i + 1] << 8));
+	}
+	boot_page_write(page);
+	boot_spm_busy_wait();
+	boot_rww_enable();
+	SREG = sreg;
+}
+
+uint8_t storage_init()
+{
+	page_valid = 0;
+	page_dirty = 0;
+	return 0;
+}
+
+void storage_flush()
+{
+	if(page_dirty)
+	{
+		flash_program_page(FLASH_STORE_START + page_addr, page_buf);
+		page_dirty = 0;
+	}
+}
+
+void storage_read(uint16_t addr, void *buf, uint16_t len)
+{
+	uint8_t *dst = buf;
+
+	while(len--)
+	{
+		if(page_valid && ((uint16_t)(addr - page_addr) < SPM_PAGESIZE)) *dst++ = page_buf[addr - page_addr];
+		else *dst++ = pgm_read_byte(FLASH_STORE_START + addr);
+		addr++;
+	}
+}
+
+void storage_write(uint16_t addr, const void *buf, uint16_t len)
+{
+	const uint8_t *src = buf;
+
+	while(len--)
+	{
+		if(!page_valid || ((uint16_t)(addr - page_addr) >= SPM_PAGESIZE))
+		{
+			storage_flush();
+			page_addr = addr & ~(SPM_PAGESIZE - 1);
+			memcpy_P(page_buf, (const void *)(FLASH_STORE_START + page_addr), SPM_PAGESIZE);
+			page_valid = 1;
+		}
+		if(page_buf[addr - page_addr] != *src)
+		{
+			page_buf[addr - page_addr] = *src;
+			page_dirty = 1;
+		}
+		src++;
+		addr++;
+	}
+}
+
+//a page is erased when it is programmed anyway
+void storage_discard(uint16_t addr, uint16_t len)
+{
+}
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * storage_i2c.c
+ *
+ * Storage backend: external 24LC256 I2C EEPROM (32 KB, see storage.h).
+ *
+ * The EEPROM is written in pages of 64 bytes, a page write costs one
+ * write cycle (max. 5 ms) no matter how many bytes of the page are
+ * written, byte writes would cost one cycle per byte. Writes are
+ * collected in a page buffer, the buffered bytes are sent as one page
+ * write when a write hits another page (or is not contiguous to the
+ * buffered bytes) and on storage_flush().
+ *
+ * The transfer runs in the TWI interrupt (twi.c), storage_flush() only
+ * starts it. The chip does not respond while it is writing, the next
+ * access polls its address until it is acknowledged again (ACK polling).
+ *
+ * Reads are one sequential read, the bytes which are still in the page
+ * buffer are taken from there.
+ */
+
+#include "common.h"
+
+#if STORAGE_BACKEND == STORAGE_I2C
+
+/// 7 bit address of the EEPROM (A2..A0 = 0)
+#define EE_ADDRESS 0x50
+#define EE_PAGE_SIZE 64
+/// max. number of address polls while the chip writes (about 30 us each)
+#define EE_POLL_MAX 1000
+
+static uint8_t page_buf[EE_PAGE_SIZE];
+static uint16_t page_addr;			///< storage address of the buffered page
+static uint8_t dirty_lo, dirty_hi;	///< buffered bytes: page_buf[dirty_lo ... dirty_hi - 1]
+static uint8_t page_dirty = 0;
+static uint8_t header[2];			///< memory address of the running transfer
+
+//wait until the chip acknowledges its address (write cycle finished)
+static uint8_t ee_ready()
+{
+	for(uint16_t i = 0; i < EE_POLL_MAX; i++)
+	{
+		twi_wait();
+		twi_start(EE_ADDRESS, 0, 0, 0, 0, TWI_WRITE_DATA);
+		if(twi_wait() == TWI_OK) return 1;
+	}
+	return 0;
+}
+
+uint8_t storage_init()
+{
+	twi_init();
+	page_dirty = 0;
+	return ee_ready() ? 0 : 1;
+}
+
+void storage_flush()
+{
+	if(!page_dirty) return;
+	ee_ready();
+	header[0] = (page_addr + dirty_lo) >> 8;
+	header[1] = (page_addr + dirty_lo) & 0xFF;
+	//page_buf is sent by the ISR, storage_write() waits before touching it again
+	twi_start(EE_ADDRESS, header, 2, &page_buf[dirty_lo], dirty_hi - dirty_lo, TWI_WRITE_DATA);
+	page_dirty = 0;
+}
+
+void storage_read(uint16_t addr, void *buf, uint16_t len)
+{
+	uint8_t *dst = buf;
+
+	ee_ready();
+	header[0] = addr >> 8;
+	header[1] = addr & 0xFF;
+	twi_start(EE_ADDRESS, header, 2, dst, len, TWI_READ_DATA);
+	twi_wait();
+
+	//the chip does not have the buffered bytes yet
+	if(!page_dirty) return;
+	for(uint16_t i = 0; i < len; i++)
+	{
+		uint16_t off = addr + i - page_addr;
+		if((off >= dirty_lo) && (off < dirty_hi)) dst[i] = page_buf[off];
+	}
+}
+
+void storage_write(uint16_t addr, const void *buf, uint16_t len)
+{
+	const uint8_t *src = buf;
+
+	while(len)
+	{
+		uint16_t page = addr & ~(EE_PAGE_SIZE - 1);
+		uint8_t off = addr - page;
+		uint8_t n = EE_PAGE_SIZE - off;
+
+		if(n > len) n = len;
+		//a page write is one contiguous range
+		if(page_dirty && ((page != page_addr) || (off > dirty_hi) || (off + n < dirty_lo))) storage_flush();
+		twi_wait();
+		if(!page_dirty)
+		{
+			page_addr = page;
+			dirty_lo = off;
+			dirty_hi = off + n;
+			page_dirty = 1;
+		}
+		else
+		{
+			if(off < dirty_lo) dirty_lo = off;
+			if(off + n > dirty_hi) dirty_hi = off + n;
+		}
+		memcpy(&page_buf[off], src, n);
+		addr += n;
+		src += n;
+		len -= n;
+	}
+}
+
+//bytes are overwritten by page writes directly
+void storage_discard(uint16_t addr, uint16_t len)
+{
+}
+
+#endif
@@ -0,0 +1,299 @@
+/*
+ * storage_spiflash.c
+ *
+ * Storage backend: external W25Qxx SPI NOR flash (see storage.h).
+ *
+ * The flash shares the SPI bus with the LCD, every command acquires the
+ * bus (spi.c) and runs with the fast flash clock. While an erase or
+ * program is in progress, the bus is released between the status polls,
+ * so the LCD can still be written.
+ *
+ * Reads are one fast read burst, a chunk of replay timings costs
+ * about 40 us.
+ *
+ * NOR flash bits can only be cleared by programming, setting bits needs
+ * a 4 KB sector erase. A write which only clears bits (appending to the
+ * erased end of the log, marking a record deleted/valid) is programmed
+ * directly. Any other write merges the sector: the sector is copied to
+ * the spare sector with the new data patched in, erased and copied back.
+ *
+ * A merge is journaled in the tag sector (4 byte entries, erased when
+ * full): the number of the target sector, a commit marker once the spare
+ * sector is complete and a done marker after the copy back. The target is
+ * only erased after the commit, storage_init() finishes a committed merge
+ * which is not done (power loss), so no data is lost.
+ */
+
+#include "common.h"
+
+#if STORAGE_BACKEND == STORAGE_SPIFLASH
+
+// Chip select of the flash
+#define CS_DDR DDRC
+#define CS_PORT PORTC
+#define CS_PIN PC0
+#define CS_SELECT CS_PORT &= ~(1 << CS_PIN);
+#define CS_UNSELECT CS_PORT |= (1 << CS_PIN);
+
+// W25Qxx instructions
+#define W25_WRITE_ENABLE 0x06
+#define W25_READ_STATUS 0x05
+#define W25_FAST_READ 0x0B
+#define W25_PAGE_PROGRAM 0x02
+#define W25_SECTOR_ERASE 0x20
+#define W25_JEDEC_ID 0x9F
+#define W25_STATUS_BUSY 0x01
+
+#define W25_PAGE_SIZE 256
+#define W25_SECTOR_SIZE 4096
+/// sector used for merging, right after the storage
+#define SPARE_SECTOR STORAGE_SIZE
+/// journal of the merges, after the spare sector (beyond 16 bit)
+#define TAG_SECTOR ((uint32_t)SPARE_SECTOR + W25_SECTOR_SIZE)
+/// tag entry: target sector | commit | done | unused
+#define TAG_ENTRY 4
+#define TAG_COMMIT 0xA5
+#define TAG_DONE 0x00
+
+/// bytes copied at once while merging a sector
+#define MERGE_CHUNK 32
+
+static void cmd_start(uint8_t cmd)
+{
+	while(!spi_acquire(SPI_OWNER_FLASH));
+	CS_SELECT
+	spi_transfer(cmd);
+}
+
+static void cmd_addr(uint8_t cmd, uint32_t addr)
+{
+	cmd_start(cmd);
+	spi_transfer(addr >> 16);
+	spi_transfer(addr >> 8);
+	spi_transfer(addr & 0xFF);
+}
+
+static void cmd_end()
+{
+	CS_UNSELECT
+	spi_release(SPI_OWNER_FLASH);
+}
+
+static void wait_ready()
+{
+	uint8_t status;
+
+	do
+	{
+		cmd_start(W25_READ_STATUS);
+		status = spi_transfer(0xFF);
+		cmd_end();
+	} while(status & W25_STATUS_BUSY);
+}
+
+static void write_enable()
+{
+	cmd_start(W25_WRITE_ENABLE);
+	cmd_end();
+}
+
+static void sector_erase(uint32_t addr)
+{
+	write_enable();
+	cmd_addr(W25_SECTOR_ERASE, addr);
+	cmd_end();
+	wait_ready();
+}
+
+//program len bytes, split at page boundaries
+static void program(uint32_t addr, const uint8_t *buf, uint16_t len)
+{
+	while(len)
+	{
+		uint16_t n = W25_PAGE_SIZE - (addr % W25_PAGE_SIZE);
+
+		if(n > len) n = len;
+		write_enable();
+		cmd_addr(W25_PAGE_PROGRAM, addr);
+		for(uint16_t i = 0; i < n; i++) spi_transfer(buf[i]);
+		cmd_end();
+		wait_ready();
+		addr += n;
+		buf += n;
+		len -= n;
+	}
+}
+
+//can the data be written without erase (bits are only cleared)?
+static uint8_t programmable(uint16_t addr, const uint8_t *buf, uint16_t len)
+{
+	uint8_t ok = 1;
+
+	cmd_addr(W25_FAST_READ, addr);
+	spi_transfer(0xFF);	//dummy byte
+	while(len--)
+	{
+		if((spi_transfer(0xFF) & *buf) != *buf) ok = 0;
+		buf++;
+	}
+	cmd_end();
+	return ok;
+}
+
+static uint8_t erased(const uint8_t *buf, uint8_t len)
+{
+	while(len--) if(*buf++ != 0xFF) return 0;
+	return 1;
+}
+
+static void flash_read(uint32_t addr, uint8_t *buf, uint16_t len)
+{
+	cmd_addr(W25_FAST_READ, addr);
+	spi_transfer(0xFF);	//dummy byte
+	while(len--) *buf++ = spi_transfer(0xFF);
+	cmd_end();
+}
+
+//offset of the first free tag entry, W25_SECTOR_SIZE if the tag sector is full
+static uint16_t tag_free()
+{
+	uint16_t off = 0;
+
+	cmd_addr(W25_FAST_READ, TAG_SECTOR);
+	spi_transfer(0xFF);	//dummy byte
+	while(off < W25_SECTOR_SIZE)
+	{
+		uint8_t target = spi_transfer(0xFF);
+
+		if(target == 0xFF) break;
+		for(uint8_t i = 1; i < TAG_ENTRY; i++) spi_transfer(0xFF);
+		off += TAG_ENTRY;
+	}
+	cmd_end();
+	return off;
+}
+
+static void tag_mark(uint16_t off, uint8_t value)
+{
+	program(TAG_SECTOR + off, &value, 1);
+}
+
+//erase the sector and copy the spare sector back
+static void copy_back(uint16_t sector)
+{
+	uint8_t buf[MERGE_CHUNK];
+
+	sector_erase(sector);
+	for(uint16_t off = 0; off < W25_SECTOR_SIZE; off += MERGE_CHUNK)
+	{
+		flash_read(SPARE_SECTOR + off, buf, MERGE_CHUNK);
+		if(!erased(buf, MERGE_CHUNK)) program(sector + off, buf, MERGE_CHUNK);
+	}
+}
+
+//rewrite the sector with the given data patched in (via the spare sector)
+static void merge(uint16_t sector, uint16_t addr, const uint8_t *src, uint16_t len)
+{
+	uint8_t buf[MERGE_CHUNK];
+	uint16_t tag = tag_free();
+
+	if(tag >= W25_SECTOR_SIZE)
+	{
+		sector_erase(TAG_SECTOR);
+		tag = 0;
+	}
+	sector_erase(SPARE_SECTOR);
+	for(uint16_t off = 0; off < W25_SECTOR_SIZE; off += MERGE_CHUNK)
+	{
+		flash_read(sector + off, buf, MERGE_CHUNK);
+		for(uint8_t i = 0; i < MERGE_CHUNK; i++)
+		{
+			uint16_t a = sector + off + i;
+			if((a >= addr) && (a - addr < len)) buf[i] = src[a - addr];
+		}
+		if(!erased(buf, MERGE_CHUNK)) program(SPARE_SECTOR + off, buf, MERGE_CHUNK);
+	}
+	tag_mark(tag, sector / W25_SECTOR_SIZE);
+	tag_mark(tag + 1, TAG_COMMIT);
+	copy_back(sector);
+	tag_mark(tag + 2, TAG_DONE);
+}
+
+//finish a merge which was interrupted after the spare sector was committed
+static void recover()
+{
+	uint8_t entry[TAG_ENTRY];
+	uint16_t tag = tag_free();
+
+	if(tag == 0) return;
+	tag -= TAG_ENTRY;
+	flash_read(TAG_SECTOR + tag, entry, TAG_ENTRY);
+	if((entry[1] != TAG_COMMIT) || (entry[2] == TAG_DONE)) return;
+	if(entry[0] >= SPARE_SECTOR / W25_SECTOR_SIZE) return;
+	copy_back(entry[0] * W25_SECTOR_SIZE);
+	tag_mark(tag + 2, TAG_DONE);
+}
+
+uint8_t storage_init()
+{
+	uint8_t manufacturer;
+
+	CS_PORT |= (1 << CS_PIN);
+	CS_DDR |= (1 << CS_PIN);
+	spi_init();
+
+	cmd_start(W25_JEDEC_ID);
+	manufacturer = spi_transfer(0xFF);
+	spi_transfer(0xFF);	//memory type
+	spi_transfer(0xFF);	//capacity
+	cmd_end();
+
+	//no chip -> MISO floats/is pulled to a constant level
+	if((manufacturer == 0x00) || (manufacturer == 0xFF)) return 1;
+	recover();
+	return 0;
+}
+
+void storage_read(uint16_t addr, void *buf, uint16_t len)
+{
+	flash_read(addr, buf, len);
+}
+
+void storage_write(uint16_t addr, const void *buf, uint16_t len)
+{
+	const uint8_t *src = buf;
+
+	while(len)
+	{
+		uint16_t sector = addr & ~(W25_SECTOR_SIZE - 1);
+		uint16_t n = sector + W25_SECTOR_SIZE - addr;
+
+		if(n > len) n = len;
+		if(programmable(addr, src, n)) program(addr, src, n);
+		else merge(sector, addr, src, n);
+		addr += n;
+		src += n;
+		len -= n;
+	}
+}
+
+//writes are not buffered
+void storage_flush()
+{
+}
+
+//erase the sectors which are completely inside the range, the following
+//writes are programmed directly instead of merging the sectors
+void storage_discard(uint16_t addr, uint16_t len)
+{
+	uint32_t end = (uint32_t)addr + len;
+	uint32_t sector = (addr + W25_SECTOR_SIZE - 1) & ~(uint32_t)(W25_SECTOR_SIZE - 1);
+
+	while(sector + W25_SECTOR_SIZE <= end)
+	{
+		sector_erase(sector);
+		sector += W25_SECTOR_SIZE;
+	}
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * stream.c
+ *
+ * This module is responsible for the IR streaming mode (see stream.h).
+ *
+ * The FIFO is filled by the request handlers and emptied by the replay
+ * source, both run in the main loop (the handlers are called from the
+ * replay source), so no locking is needed.
+ */
+
+#include "common.h"
+
+#define FIFO_MASK (STREAM_FIFO_SIZE - 1)
+
+static uint16_t fifo[STREAM_FIFO_SIZE];
+static uint8_t head = 0;		///< next write position
+static uint8_t tail = 0;		///< next read position
+static uint8_t state = STREAM_IDLE;
+static uint8_t ended = 0;		///< FRAME_STREAM_END received
+static uint16_t received = 0;	///< timings queued since FRAME_STREAM_BEGIN
+static uint8_t waiting = 0;		///< IR_SOURCE_WAIT returned since the last timings
+static uint16_t waiting_since;	///< tick_ms() of the first IR_SOURCE_WAIT
+static uint8_t result = STREAM_OK;
+static ir_source_t src;			///< replay source, counts emitted timings and underruns
+
+static uint8_t fifo_used()
+{
+	return (head - tail) & (2 * STREAM_FIFO_SIZE - 1);
+}
+
+static uint8_t status(uint8_t *reply, uint8_t *reply_len)
+{
+	reply[0] = STREAM_FIFO_SIZE - fifo_used();
+	reply[1] = state;
+	reply[2] = src.stalls & 0xFF;
+	reply[3] = src.stalls >> 8;
+	for(uint8_t i = 0; i < 4; i++) reply[4 + i] = src.emitted >> (8 * i);
+	reply[8] = result;
+	*reply_len = STREAM_STATUS_SIZE;
+	return 0;
+}
+
+/** @brief FRAME_STREAM_BEGIN: empty the FIFO, start collecting timings */
+uint8_t stream_begin(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	if(state == STREAM_PLAY) return FRAME_NAK_STATE;
+	head = tail = 0;
+	received = 0;
+	ended = 0;
+	src.emitted = 0;
+	src.stalls = 0;
+	result = STREAM_OK;
+	state = STREAM_FILL;
+	return status(reply, reply_len);
+}
+
+/** @brief FRAME_STREAM_DATA: queue timings */
+uint8_t stream_data(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	uint16_t offset;
+	uint8_t n;
+
+	if((state == STREAM_IDLE) || ended) return FRAME_NAK_STATE;
+	if((len < 4) || (len & 1)) return FRAME_NAK_LENGTH;
+	offset = payload[0] | (payload[1] << 8);
+	n = (len - 2) / 2;
+	//retransmission of the last chunk (ACK lost), it is queued already
+	if((uint16_t)(received - offset) == n) return status(reply, reply_len);
+	if(offset != received) return FRAME_NAK_STATE;
+	if(n > STREAM_FIFO_SIZE - fifo_used()) return FRAME_NAK_LENGTH;
+
+	for(uint8_t i = 0; i < n; i++)
+	{
+		fifo[head & FIFO_MASK] = payload[2 + 2 * i] | (payload[3 + 2 * i] << 8);
+		head = (head + 1) & (2 * STREAM_FIFO_SIZE - 1);
+	}
+	received += n;
+	return status(reply, reply_len);
+}
+
+/** @brief FRAME_STREAM_END: no more timings, the replay ends with the FIFO */
+uint8_t stream_end(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	if(state == STREAM_IDLE) return FRAME_NAK_STATE;
+	ended = 1;
+	return status(reply, reply_len);
+}
+
+/** @brief FRAME_STREAM_STATUS: status only */
+uint8_t stream_status(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	return status(reply, reply_len);
+}
+
+/** @brief Is a stream being replayed? (see proto_poll()) */
+uint8_t stream_playing()
+{
+	return state == STREAM_PLAY;
+}
+
+//replay source reading the FIFO, the offset is not needed
+static uint8_t source_read(ir_source_t *src, uint16_t offset, uint16_t *buf, uint8_t count)
+{
+	uint8_t n = 0;
+
+	//handle a request first when the next chunk of the host fits, the
+	//frame is not unpacked on every edge
+	if((fifo_used() < STREAM_POLL_LEVEL) && uart_frame_ready()) proto_poll();
+	if((fifo_used() < count) && !ended)
+	{
+		//underrun: the replay waits (asks again on the next edge), unless
+		//the host is gone
+		if(!waiting)
+		{
+			waiting = 1;
+			waiting_since = tick_ms();
+		}
+		if((uint16_t)(tick_ms() - waiting_since) < STREAM_TIMEOUT_MS) return IR_SOURCE_WAIT;
+		ended = 1;
+		result = STREAM_ERR_TIMEOUT;
+	}
+	waiting = 0;
+	while((n < count) && fifo_used())
+	{
+		buf[n++] = fifo[tail & FIFO_MASK];
+		tail = (tail + 1) & (2 * STREAM_FIFO_SIZE - 1);
+	}
+	return n;
+}
+
+/** @brief Run the replay of a stream if it is ready to start
+ *
+ * Called from the main loop after proto_poll(). Blocks until the stream
+ * has ended (or timed out), the requests are handled meanwhile.
+ */
+void stream_poll()
+{
+	if(state != STREAM_FILL) return;
+	if((fifo_used() < STREAM_START_LEVEL) && !ended) return;
+	src.read = source_read;
+	src.data = 0;
+	src.addr = 0;
+	src.len = 0;
+	waiting = 0;
+	state = STREAM_PLAY;
+	if(ir_play_source(&src) == IR_PLAY_BUSY) result = STREAM_ERR_BUSY;
+	state = STREAM_IDLE;
+}
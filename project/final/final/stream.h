@@ -0,0 +1,85 @@
+/*
+ * stream.h
+ *
+ * This module is responsible for the IR streaming mode: the host streams
+ * timings over the binary protocol (see proto.h) and the device emits
+ * them while they arrive, like a USB IR blaster. The length of a stream
+ * is not limited (no MAX_IR_EDGES), any protocol can be synthesized on
+ * the host (tools/irlink stream).
+ *
+ *   FRAME_STREAM_BEGIN   -> ACK: status
+ *   FRAME_STREAM_DATA    offset (2B) | timings (max. STREAM_CHUNK * 2B) -> ACK: status
+ *   FRAME_STREAM_END     -> ACK: status
+ *   FRAME_STREAM_STATUS  -> ACK: status
+ *
+ *   status: credits (1B) | state (1B) | underruns (2B) | emitted (4B) | result (1B)
+ *
+ * (multi byte values little endian)
+ *
+ * The timings are in us and have the ir_timings layout: the first one is
+ * a space (usually 0), then mark, space, mark, ... A space longer than
+ * 65535 us is split by a mark of 0 us.
+ *
+ * offset is the number of the first timing in the stream (mod 65536), a
+ * retransmitted chunk is not queued twice. The timings are queued in a
+ * FIFO of STREAM_FIFO_SIZE timings, credits is the free space in it: the
+ * host must not send more timings than the last credits (credit based
+ * flow control). The replay starts when the FIFO is filled up to
+ * STREAM_START_LEVEL (or at FRAME_STREAM_END) and ends when FRAME_STREAM_END
+ * was received and the FIFO is empty. While the replay runs, the stream
+ * requests are handled between the edges (see ir_play_source()) when the
+ * FIFO is below STREAM_POLL_LEVEL, any other request is rejected
+ * (FRAME_NAK_STATE, see proto.h). If the FIFO runs empty before the end, the
+ * current edge is stretched until the next timings arrive (underruns is
+ * incremented). After STREAM_TIMEOUT_MS without timings the stream is
+ * ended (the host is gone), further FRAME_STREAM_DATA are rejected.
+ */
+
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+/** @brief Number of timings buffered (power of 2, max. 128) */
+#define STREAM_FIFO_SIZE 64
+/** @brief Fill level of the FIFO which starts the replay */
+#define STREAM_START_LEVEL (STREAM_FIFO_SIZE * 3 / 4)
+/** @brief Max number of timings in one FRAME_STREAM_DATA request */
+#define STREAM_CHUNK ((FRAME_MAX_PAYLOAD - 2) / 2)
+/** @brief Fill level below which the replay handles requests (a whole chunk fits) */
+#define STREAM_POLL_LEVEL (STREAM_FIFO_SIZE - STREAM_CHUNK)
+/** @brief An underrun longer than this in ms ends the stream */
+#define STREAM_TIMEOUT_MS 500
+
+/** @brief Stream states */
+#define STREAM_IDLE 0		///< no stream, FRAME_STREAM_DATA is rejected
+#define STREAM_FILL 1		///< collecting timings before the replay starts
+#define STREAM_PLAY 2		///< replay running
+/** @brief Result of the last replay (status), reset by FRAME_STREAM_BEGIN */
+#define STREAM_OK 0			///< running or ended normally
+#define STREAM_ERR_BUSY 1	///< not replayed, a recording holds the timers
+#define STREAM_ERR_TIMEOUT 2	///< ended after an underrun of STREAM_TIMEOUT_MS
+/** @brief Size of the status (ACK payload) */
+#define STREAM_STATUS_SIZE 9
+
+/** @brief FRAME_STREAM_BEGIN: empty the FIFO, start collecting timings */
+uint8_t stream_begin(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len);
+
+/** @brief FRAME_STREAM_DATA: queue timings */
+uint8_t stream_data(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len);
+
+/** @brief FRAME_STREAM_END: no more timings, the replay ends with the FIFO */
+uint8_t stream_end(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len);
+
+/** @brief FRAME_STREAM_STATUS: status only */
+uint8_t stream_status(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len);
+
+/** @brief Is a stream being replayed? (see proto_poll()) */
+uint8_t stream_playing();
+
+/** @brief Run the replay of a stream if it is ready to start
+ *
+ * Called from the main loop after proto_poll(). Blocks until the stream
+ * has ended (or timed out), the requests are handled meanwhile.
+ */
+void stream_poll();
+
+#endif /* _STREAM_H_ */
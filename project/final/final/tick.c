@@ -0,0 +1,49 @@
+/*
+ * tick.c
+ *
+ * This module is responsible for the system tick (see tick.h).
+ */
+
+#include "common.h"
+
+static volatile uint16_t ms = 0;
+static uint8_t half = 0;
+
+/** @brief Start Timer2 and the millisecond tick
+ *
+ * Must run before the LCD and the buttons are used.
+ * Calling it more than once is harmless.
+ */
+void tick_init()
+{
+	if(TCCR2B != 0) return;
+	TCCR2A = 0;
+	OCR2A = TCNT2 + TICK_COMPARE;
+	TIFR2 = (1 << OCF2A);
+	TIMSK2 |= (1 << OCIE2A);
+	TCCR2B = TICK_TIMER_CS;
+}
+
+/** @brief Milliseconds since tick_init()
+ * @return ms (wraps after 65.5 s, compare differences only)
+ */
+uint16_t tick_ms()
+{
+	uint16_t now;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		now = ms;
+	}
+	return now;
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+	OCR2A += TICK_COMPARE;		//8 bit, wraps with the counter
+	half ^= 1;
+	if(half) return;
+	ms++;
+	keys_tick(ms);
+	sched_tick();
+}
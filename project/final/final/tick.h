@@ -0,0 +1,44 @@
+/*
+ * tick.h
+ *
+ * This module is responsible for the system tick: Timer2 runs free at
+ * clk/32 (TICK_TIMER_US per count) and is shared by
+ *
+ *   compare A: the millisecond tick (every TICK_COMPARE counts, twice
+ *              per ms), which runs the button debouncing (keys.h)
+ *              and the run time accounting of the tasks (sched.h)
+ *   compare B: the one shot settle times of the LCD queue (dogm_lcd.c)
+ *
+ * The counter is never written or stopped, each user sets its compare
+ * register relative to TCNT2.
+ */
+
+#ifndef _TICK_H_
+#define _TICK_H_
+
+#include <stdint.h>
+
+/** @brief Timer2 resolution in us (clk/32 at 16 MHz) */
+#define TICK_TIMER_US 2
+#define TICK_TIMER_CS ((1 << CS21) | (1 << CS20))
+
+/** @brief Counts between two compare A interrupts (0.5 ms) */
+#define TICK_COMPARE 250
+
+#if F_CPU != 16000000UL
+#error "tick.h: Timer2 prescaler and TICK_COMPARE assume F_CPU = 16 MHz"
+#endif
+
+/** @brief Start Timer2 and the millisecond tick
+ *
+ * Must run before the LCD and the buttons are used.
+ * Calling it more than once is harmless.
+ */
+void tick_init();
+
+/** @brief Milliseconds since tick_init()
+ * @return ms (wraps after 65.5 s, compare differences only)
+ */
+uint16_t tick_ms();
+
+#endif /* _TICK_H_ */
@@ -0,0 +1,110 @@
+/*
+ * eepgen.c
+ *
+ * Host tool: builds a ready-to-flash EEPROM image (Intel HEX, .eep) of
+ * a command library from the text command database (format see irdb.h).
+ * The image has exactly the layout eeprom_init() / eeprom_load_command()
+ * expect (see eeprom.h), the commands get the indices in name order.
+ *
+ * usage: eepgen [-s size] <database> <output.eep>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "irdb.h"
+#include "../ir.h"
+#include "../eeprom.h"
+
+static int write_hex(const char *fname, const uint8_t *mem, size_t size)
+{
+	FILE *fp = fopen(fname, "w");
+
+	if(!fp) { perror(fname); return 1; }
+	for(size_t addr = 0; addr < size; addr += 16)
+	{
+		size_t n = (size - addr < 16) ? size - addr : 16;
+		uint8_t sum = n + (addr >> 8) + (addr & 0xFF);
+
+		fprintf(fp, ":%02zX%04zX00", n, addr);
+		for(size_t i = 0; i < n; i++)
+		{
+			fprintf(fp, "%02X", mem[addr + i]);
+			sum += mem[addr + i];
+		}
+		fprintf(fp, "%02X\n", (uint8_t)-sum);
+	}
+	fprintf(fp, ":00000001FF\n");
+	return fclose(fp) ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	size_t size = 1024;	//ATmega328p, E2END + 1
+	irdb_entry_t *list;
+	size_t count, addr;
+	uint8_t *mem;
+	FILE *fp;
+
+	if(argc == 5 && strcmp(argv[1], "-s") == 0)
+	{
+		size = strtoul(argv[2], NULL, 0);
+		argv += 2;
+		argc -= 2;
+	}
+	if(argc != 3 || size < EEPROM_HEADER_SIZE + 1 || size > 0x10000)
+	{
+		fprintf(stderr, "usage: %s [-s size] <database> <output.eep>\n", argv[0]);
+		return 2;
+	}
+
+	fp = fopen(argv[1], "r");
+	if(!fp) { perror(argv[1]); return 1; }
+	list = irdb_parse(fp, argv[1], &count);
+	fclose(fp);
+	if(!list) return 1;
+
+	mem = malloc(size);
+	memset(mem, 0xFF, size);
+	mem[0] = EEPROM_MAGIC_0;
+	mem[1] = EEPROM_MAGIC_1;
+	mem[2] = EEPROM_VERSION;
+
+	addr = EEPROM_HEADER_SIZE;
+	for(size_t i = 0; i < count; i++)
+	{
+		uint16_t timings[IRDB_MAX_RAW + 1];
+		size_t edges = irdb_timings(&list[i], timings);
+		size_t rec = EEPROM_REC_HEADER_SIZE + 2 * edges;
+
+		if(i >= EEPROM_MAX_COMMANDS)
+		{
+			fprintf(stderr, "%s: more than %d commands\n", argv[1], EEPROM_MAX_COMMANDS);
+			return 1;
+		}
+		if(strlen(list[i].name) > MAX_NAME_LEN - 1)
+		{
+			fprintf(stderr, "%s: name '%s' longer than %d chars\n", argv[1], list[i].name, MAX_NAME_LEN - 1);
+			return 1;
+		}
+		if(edges >= MAX_IR_EDGES || addr + rec > size)
+		{
+			fprintf(stderr, "%s: '%s' does not fit (%zu of %zu bytes used)\n", argv[1], list[i].name, addr, size);
+			return 1;
+		}
+		mem[addr] = EEPROM_REC_VALID;
+		mem[addr + 1] = edges;
+		memset(&mem[addr + 2], 0, MAX_NAME_LEN);
+		memcpy(&mem[addr + 2], list[i].name, strlen(list[i].name));
+		for(size_t k = 0; k < edges; k++)
+		{
+			mem[addr + EEPROM_REC_HEADER_SIZE + 2 * k] = timings[k] & 0xFF;		//little endian like AVR
+			mem[addr + EEPROM_REC_HEADER_SIZE + 2 * k + 1] = timings[k] >> 8;
+		}
+		addr += rec;
+	}
+	//rest stays 0xFF -> end of log
+
+	fprintf(stderr, "%s: %zu commands, %zu of %zu bytes used\n", argv[2], count, addr, size);
+	free(list);
+	return write_hex(argv[2], mem, size);
+}
@@ -0,0 +1,157 @@
+/*
+ * irdb.c
+ *
+ * Host tool module: parser for the text command database (irlib.txt).
+ * See irdb.h for the format.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "irdb.h"
+#include "../ir.h"
+
+static int parse_num(const char *tok, unsigned long max, unsigned long *val)
+{
+	char *end;
+
+	errno = 0;
+	*val = strtoul(tok, &end, 0);
+	return (errno == 0) && (*end == 0) && (end != tok) && (*val <= max);
+}
+
+static int cmp_name(const void *a, const void *b)
+{
+	return strcmp(((const irdb_entry_t *)a)->name, ((const irdb_entry_t *)b)->name);
+}
+
+irdb_entry_t *irdb_parse(FILE *fp, const char *fname, size_t *count)
+{
+	irdb_entry_t *list = NULL;
+	size_t n = 0, cap = 0;
+	unsigned lineno = 0;
+	char line[4096];
+	int err = 0;
+
+	while(fgets(line, sizeof(line), fp))
+	{
+		char *tok[3 + IRDB_MAX_RAW + 1];
+		size_t ntok = 0;
+		char *hash = strchr(line, '#');
+		char *t;
+		irdb_entry_t *e;
+		unsigned long v;
+
+		lineno++;
+		if(hash) *hash = 0;
+		for(t = strtok(line, " \t\r\n"); t && ntok < sizeof(tok) / sizeof(tok[0]); t = strtok(NULL, " \t\r\n"))
+			tok[ntok++] = t;
+		if(ntok == 0) continue;
+
+		if(n == cap)
+		{
+			cap = cap ? cap * 2 : 64;
+			list = realloc(list, cap * sizeof(*list));
+			if(!list) { perror("realloc"); return NULL; }
+		}
+		e = &list[n];
+		memset(e, 0, sizeof(*e));
+
+		if(ntok < 4 || strlen(tok[0]) + 1 + strlen(tok[1]) >= IRDB_NAME_LEN)
+		{
+			fprintf(stderr, "%s:%u: expected <device> <button> <protocol> <code>, name max %d chars\n",
+				fname, lineno, IRDB_NAME_LEN - 1);
+			err = 1;
+			continue;
+		}
+		strcpy(e->name, tok[0]);
+		strcat(e->name, ".");
+		strcat(e->name, tok[1]);
+
+		if(strcmp(tok[2], "nec") == 0)
+		{
+			unsigned long cmd;
+
+			if(ntok != 5 || !parse_num(tok[3], 0xFFFF, &v) || !parse_num(tok[4], 0xFF, &cmd))
+			{
+				fprintf(stderr, "%s:%u: nec expects <address> <command>\n", fname, lineno);
+				err = 1;
+				continue;
+			}
+			e->protocol = (v > 0xFF) ? IRDB_NECX : IRDB_NEC;
+			e->address = v;
+			e->command = cmd;
+		}
+		else if(strcmp(tok[2], "raw") == 0)
+		{
+			size_t i;
+
+			e->protocol = IRDB_RAW;
+			if(ntok - 3 > IRDB_MAX_RAW)
+			{
+				fprintf(stderr, "%s:%u: more than %d raw timings\n", fname, lineno, IRDB_MAX_RAW);
+				err = 1;
+				continue;
+			}
+			for(i = 3; i < ntok; i++)
+			{
+				if(!parse_num(tok[i], 0xFFFF, &v) || v < 2)
+				{
+					fprintf(stderr, "%s:%u: invalid timing '%s'\n", fname, lineno, tok[i]);
+					err = 1;
+					break;
+				}
+				e->raw[e->raw_len++] = v;
+			}
+			if(i < ntok) continue;
+		}
+		else
+		{
+			fprintf(stderr, "%s:%u: unknown protocol '%s'\n", fname, lineno, tok[2]);
+			err = 1;
+			continue;
+		}
+		n++;
+	}
+
+	qsort(list, n, sizeof(*list), cmp_name);
+	for(size_t i = 1; i < n; i++)
+	{
+		if(strcmp(list[i - 1].name, list[i].name) == 0)
+		{
+			fprintf(stderr, "%s: duplicate command '%s'\n", fname, list[i].name);
+			err = 1;
+		}
+	}
+	if(err) { free(list); return NULL; }
+	*count = n;
+	return list ? list : calloc(1, sizeof(*list));
+}
+
+size_t irdb_timings(const irdb_entry_t *e, uint16_t *out)
+{
+	size_t n = 0;
+
+	out[n++] = 0;
+	if(e->protocol == IRDB_RAW)
+	{
+		for(size_t i = 0; i < e->raw_len; i++) out[n++] = e->raw[i];
+		return n;
+	}
+
+	uint8_t bytes[4] = {
+		e->address & 0xFF,
+		(e->protocol == IRDB_NECX) ? (e->address >> 8) : (uint8_t)~e->address,
+		e->command,
+		(uint8_t)~e->command
+	};
+	out[n++] = NEC_LEAD_MARK;
+	out[n++] = NEC_LEAD_SPACE;
+	for(int bit = 0; bit < 32; bit++)
+	{
+		out[n++] = NEC_BIT_MARK;
+		out[n++] = (bytes[bit / 8] & (1 << (bit % 8))) ? NEC_ONE_SPACE : NEC_ZERO_SPACE;
+	}
+	out[n++] = NEC_BIT_MARK;
+	return n;
+}
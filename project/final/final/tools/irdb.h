@@ -0,0 +1,66 @@
+/*
+ * irdb.h
+ *
+ * Host tool module: parser for the text command database (irlib.txt).
+ *
+ * One command per line, '#' starts a comment:
+ *
+ *   <device> <button> nec  <address> <command>
+ *   <device> <button> raw  <mark> <space> <mark> ...      (in us)
+ *
+ * The NEC address is 8 bit (standard) or 16 bit (extended NEC), the
+ * command is 8 bit. Numbers are decimal or hex (0x..). The command name
+ * is "device.button".
+ */
+
+#ifndef _IRDB_H_
+#define _IRDB_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "../ir.h"
+
+/// max length of "device.button" incl. \0 (same as IRLIB_NAME_LEN)
+#define IRDB_NAME_LEN 17
+/// max number of raw timings (leading space + terminator are added)
+#define IRDB_MAX_RAW (MAX_IR_EDGES - 2)
+
+/// protocols, same numbers as IRLIB_NEC, IRLIB_NECX, IRLIB_RAW
+#define IRDB_NEC 0
+#define IRDB_NECX 1
+#define IRDB_RAW 2
+
+typedef struct
+{
+	char name[IRDB_NAME_LEN];
+	uint8_t protocol;
+	uint16_t address;
+	uint8_t command;
+	uint16_t raw_len;
+	uint16_t raw[IRDB_MAX_RAW];
+} irdb_entry_t;
+
+/** @brief Parse a database file
+ *
+ * The entries are returned sorted by name. Errors are printed to stderr
+ * (with file name and line number).
+ *
+ * @param fp Opened database file
+ * @param fname File name for error messages
+ * @param count (out) -> number of entries
+ * @return Array of entries (malloc'ed), NULL on error
+ */
+irdb_entry_t *irdb_parse(FILE *fp, const char *fname, size_t *count);
+
+/** @brief Expand an entry to timings in ir_timings layout
+ *
+ * Index 0 is the space before the first mark, odd indices are marks.
+ * No terminator is added.
+ *
+ * @param e Entry
+ * @param out Array of at least IRDB_MAX_RAW + 1 timings
+ * @return Number of timings
+ */
+size_t irdb_timings(const irdb_entry_t *e, uint16_t *out);
+
+#endif /* _IRDB_H_ */
@@ -0,0 +1,82 @@
+/*
+ * irlibgen.c
+ *
+ * Host tool: compiles the text command database (irlib.txt) into the
+ * PROGMEM tables of the built-in command library (irlib_table.h).
+ *
+ * usage: irlibgen <database> > irlib_table.h
+ *
+ * Output:
+ *   irlib_names[]   name pool ("device.button\0...")
+ *   irlib_data[]    data pool (NEC: address, command; raw: timings)
+ *   irlib_entries[] one irlib_entry_t per command, sorted by name
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "irdb.h"
+
+int main(int argc, char **argv)
+{
+	irdb_entry_t *list;
+	size_t count, i;
+	unsigned name_off = 0, data_off = 0;
+	FILE *fp;
+
+	if(argc != 2)
+	{
+		fprintf(stderr, "usage: %s <database>\n", argv[0]);
+		return 2;
+	}
+	fp = fopen(argv[1], "r");
+	if(!fp) { perror(argv[1]); return 1; }
+	list = irdb_parse(fp, argv[1], &count);
+	fclose(fp);
+	if(!list) return 1;
+
+	printf("/* generated by tools/irlibgen from %s, do not edit */\n\n", argv[1]);
+	printf("#define IRLIB_COUNT %zu\n\n", count);
+
+	printf("static const char irlib_names[] PROGMEM =\n");
+	for(i = 0; i < count; i++) printf("\t\"%s\\0\"\n", list[i].name);
+	printf("\t\"\";\n\n");
+
+	printf("static const uint16_t irlib_data[] PROGMEM = {\n");
+	for(i = 0; i < count; i++)
+	{
+		irdb_entry_t *e = &list[i];
+
+		if(e->protocol == IRDB_RAW)
+		{
+			printf("\t0,");
+			for(size_t k = 0; k < e->raw_len; k++) printf("%s%u,", (k % 12 == 11) ? "\n\t" : " ", e->raw[k]);
+			printf("\n");
+		}
+		else printf("\t0x%04X, 0x%02X,\n", e->address, e->command);
+	}
+	printf("\t0\n};\n\n");
+
+	printf("static const irlib_entry_t irlib_entries[] PROGMEM = {\n");
+	for(i = 0; i < count; i++)
+	{
+		irdb_entry_t *e = &list[i];
+		unsigned len = (e->protocol == IRDB_RAW) ? e->raw_len + 1 : 2;
+		static const char *proto[] = { "IRLIB_NEC", "IRLIB_NECX", "IRLIB_RAW" };
+
+		if(name_off > 0xFFFF || data_off + len > 0xFFFF)
+		{
+			fprintf(stderr, "%s: library too large\n", argv[1]);
+			return 1;
+		}
+		printf("\t{ %u, %s, %u, %u },\t/* %s */\n", name_off, proto[e->protocol], len, data_off, e->name);
+		name_off += strlen(e->name) + 1;
+		data_off += len;
+	}
+	if(count == 0) printf("\t{ 0, 0, 0, 0 }\n");
+	printf("};\n");
+
+	fprintf(stderr, "%s: %zu commands, %u bytes flash\n", argv[1], count,
+		(unsigned)(name_off + 2 * data_off + count * 6));
+	free(list);
+	return 0;
+}
@@ -0,0 +1,470 @@
+/*
+ * irlink.c
+ *
+ * Host tool: talks to the device with the binary protocol (see proto.h).
+ *
+ * usage: irlink [-p port] [-b baud] <command> [args]
+ *
+ *   info               protocol version, frame size, storage size, baudrate
+ *   ping               one round trip
+ *   bench [seconds]    throughput: max. size PING frames (default 5 s)
+ *   export <file>      save the command library image to a file
+ *   import <file>      replace the command library by an image file
+ *   stream <file>      emit the timings of a text file (us, mark space mark ...)
+ *   stream-bench       max. edge rate of the streaming mode without underrun
+ *   sniff [seconds]    print every received interval (until Ctrl-C by default)
+ *   events [seconds]   print the decoded keys (until Ctrl-C by default)
+ *
+ * export/import clone a library between units (see xfer.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include "link.h"
+#include "../xfer.h"
+#include "../stream.h"
+#include "../sniff.h"
+#include "../irdec.h"
+
+static int cmd_info(link_t *l, int argc, char **argv)
+{
+	uint8_t r[FRAME_MAX_PAYLOAD];
+	int n = link_request(l, FRAME_INFO, 0, 0, r);
+
+	if(n < 8)
+	{
+		fprintf(stderr, "info: error %d\n", n);
+		return 1;
+	}
+	printf("protocol %u, payload %u B, storage %u B, %u baud\n", r[0], r[1],
+		r[2] | (r[3] << 8), r[4] | (r[5] << 8) | (r[6] << 16) | ((unsigned)r[7] << 24));
+	return 0;
+}
+
+static int cmd_ping(link_t *l, int argc, char **argv)
+{
+	double t = link_time();
+	int n = link_request(l, FRAME_PING, "ping", 4, 0);
+
+	if(n != 4)
+	{
+		fprintf(stderr, "ping: error %d\n", n);
+		return 1;
+	}
+	printf("round trip %.3f ms\n", (link_time() - t) * 1000);
+	return 0;
+}
+
+static int cmd_bench(link_t *l, int argc, char **argv)
+{
+	double seconds = (argc > 1) ? atof(argv[1]) : 5.0;
+	uint8_t p[FRAME_MAX_PAYLOAD], r[FRAME_MAX_PAYLOAD];
+	unsigned long frames = 0, errors = 0;
+	double start = link_time(), t;
+
+	do
+	{
+		for(int i = 0; i < FRAME_MAX_PAYLOAD; i++) p[i] = rand();
+		if(link_request(l, FRAME_PING, p, FRAME_MAX_PAYLOAD, r) != FRAME_MAX_PAYLOAD ||
+			memcmp(p, r, FRAME_MAX_PAYLOAD)) errors++;
+		else frames++;
+		t = link_time() - start;
+	} while(t < seconds);
+
+	printf("%lu frames in %.2f s: %.0f frames/s, %.0f payload B/s per direction\n",
+		frames, t, frames / t, frames * FRAME_MAX_PAYLOAD / t);
+	printf("%lu errors, %u retransmits, %u NAKs\n", errors, l->retransmits, l->naks);
+	return errors ? 1 : 0;
+}
+
+static int cmd_export(link_t *l, int argc, char **argv)
+{
+	uint8_t r[FRAME_MAX_PAYLOAD], p[3];
+	uint8_t *image;
+	unsigned size, crc;
+	double t = link_time();
+	FILE *f;
+	int n;
+
+	if(argc != 2)
+	{
+		fprintf(stderr, "export: file missing\n");
+		return 2;
+	}
+	n = link_request(l, FRAME_LIB_INFO, 0, 0, r);
+	if(n != 5)
+	{
+		fprintf(stderr, "export: error %d\n", n);
+		return 1;
+	}
+	size = r[0] | (r[1] << 8);
+	crc = r[2] | (r[3] << 8);
+	image = malloc(size);
+	for(unsigned addr = 0; addr < size; addr += n)
+	{
+		p[0] = addr & 0xFF;
+		p[1] = addr >> 8;
+		p[2] = (size - addr > FRAME_MAX_PAYLOAD) ? FRAME_MAX_PAYLOAD : size - addr;
+		n = link_request(l, FRAME_READ, p, 3, image + addr);
+		if(n != p[2])
+		{
+			fprintf(stderr, "export: error %d at %u\n", n, addr);
+			return 1;
+		}
+	}
+	t = link_time() - t;
+	if(frame_crc16(0, image, size) != crc)
+	{
+		fprintf(stderr, "export: CRC mismatch\n");
+		return 1;
+	}
+	f = fopen(argv[1], "wb");
+	if(!f || fwrite(image, 1, size, f) != size || fclose(f))
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	printf("%u commands, %u B in %.2f s: %.0f B/s\n", r[4], size, t, size / t);
+	free(image);
+	return 0;
+}
+
+static int cmd_import(link_t *l, int argc, char **argv)
+{
+	uint8_t p[FRAME_MAX_PAYLOAD], r[FRAME_MAX_PAYLOAD];
+	uint8_t image[0x10000];
+	unsigned size, crc, timeout = l->timeout_ms;
+	double t = link_time();
+	FILE *f;
+	int n;
+
+	if(argc != 2)
+	{
+		fprintf(stderr, "import: file missing\n");
+		return 2;
+	}
+	f = fopen(argv[1], "rb");
+	if(!f)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	size = fread(image, 1, sizeof(image), f);
+	fclose(f);
+	crc = frame_crc16(0, image, size);
+
+	//one chunk to the internal EEPROM takes about 200 ms,
+	//the SPI flash erases a sector (<= 400 ms) when a chunk reaches it
+	l->timeout_ms = 1000;
+	p[0] = size & 0xFF;
+	p[1] = size >> 8;
+	n = link_request(l, FRAME_IMPORT_BEGIN, p, 2, 0);
+	if(n < 0)
+	{
+		fprintf(stderr, "import: begin error %d (image too large?)\n", n);
+		return 1;
+	}
+	for(unsigned addr = 0; addr < size; addr += XFER_CHUNK)
+	{
+		uint8_t len = (size - addr > XFER_CHUNK) ? XFER_CHUNK : size - addr;
+
+		p[0] = addr & 0xFF;
+		p[1] = addr >> 8;
+		memcpy(&p[2], &image[addr], len);
+		n = link_request(l, FRAME_IMPORT_DATA, p, len + 2, 0);
+		if(n < 0)
+		{
+			fprintf(stderr, "import: error %d at %u\n", n, addr);
+			return 1;
+		}
+	}
+	p[0] = crc & 0xFF;
+	p[1] = crc >> 8;
+	n = link_request(l, FRAME_IMPORT_END, p, 2, r);
+	l->timeout_ms = timeout;
+	if(n != 1)
+	{
+		fprintf(stderr, "import: %s (error %d)\n", (n == -FRAME_NAK_CHECK) ? "verification failed" : "end", n);
+		return 1;
+	}
+	t = link_time() - t;
+	printf("%u commands, %u B in %.2f s: %.0f B/s\n", r[0], size, t, size / t);
+	printf("%u retransmits, %u NAKs\n", l->retransmits, l->naks);
+	return 0;
+}
+
+//stream timings (ir_timings layout), returns the number of underruns or -1
+static int stream(link_t *l, const uint16_t *t, unsigned n)
+{
+	uint8_t p[FRAME_MAX_PAYLOAD], r[FRAME_MAX_PAYLOAD];
+	unsigned sent = 0, credits;
+	int ret;
+
+	ret = link_request(l, FRAME_STREAM_BEGIN, 0, 0, r);
+	while(ret == STREAM_STATUS_SIZE)
+	{
+		credits = r[0];
+		if(sent == n) break;
+		if(credits == 0)
+		{
+			//FIFO full, the replay empties it
+			ret = link_request(l, FRAME_STREAM_STATUS, 0, 0, r);
+			continue;
+		}
+		if(credits > STREAM_CHUNK) credits = STREAM_CHUNK;
+		if(credits > n - sent) credits = n - sent;
+		p[0] = sent & 0xFF;
+		p[1] = (sent >> 8) & 0xFF;
+		for(unsigned i = 0; i < credits; i++)
+		{
+			p[2 + 2 * i] = t[sent + i] & 0xFF;
+			p[3 + 2 * i] = t[sent + i] >> 8;
+		}
+		ret = link_request(l, FRAME_STREAM_DATA, p, 2 + 2 * credits, r);
+		if(ret == -FRAME_NAK_STATE) break;	//ended by the timeout of an underrun
+		sent += credits;
+	}
+	if(ret == STREAM_STATUS_SIZE) ret = link_request(l, FRAME_STREAM_END, 0, 0, r);
+	//wait for the end of the replay
+	while(ret == STREAM_STATUS_SIZE && r[1] != STREAM_IDLE) ret = link_request(l, FRAME_STREAM_STATUS, 0, 0, r);
+	if(ret != STREAM_STATUS_SIZE) ret = link_request(l, FRAME_STREAM_STATUS, 0, 0, r);
+	if(ret != STREAM_STATUS_SIZE)
+	{
+		fprintf(stderr, "stream: error %d\n", ret);
+		return -1;
+	}
+	if(r[8] == STREAM_ERR_BUSY)
+	{
+		fprintf(stderr, "stream: device busy (recording)\n");
+		return -1;
+	}
+	if(r[8] == STREAM_ERR_TIMEOUT) fprintf(stderr, "stream: ended by an underrun timeout\n");
+	return r[2] | (r[3] << 8);
+}
+
+static int cmd_stream(link_t *l, int argc, char **argv)
+{
+	static uint16_t t[1 << 20];
+	unsigned n = 1, v;
+	FILE *f;
+
+	if(argc != 2)
+	{
+		fprintf(stderr, "stream: file missing\n");
+		return 2;
+	}
+	f = fopen(argv[1], "r");
+	if(!f)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	//leading space, long spaces are split by marks of 0 us
+	t[0] = 0;
+	while(n < sizeof(t) / sizeof(t[0]) - 2 && fscanf(f, "%u", &v) == 1)
+	{
+		while(v > 0xFFFF && (n % 2) == 0 && n < sizeof(t) / sizeof(t[0]) - 2)
+		{
+			t[n++] = 0xFFFF;
+			t[n++] = 0;
+			v -= 0xFFFF;
+		}
+		t[n++] = (v > 0xFFFF) ? 0xFFFF : v;
+	}
+	fclose(f);
+	v = stream(l, t, n);
+	if((int)v < 0) return 1;
+	printf("%u timings, %u underruns\n", n - 1, v);
+	return v ? 1 : 0;
+}
+
+static int cmd_stream_bench(link_t *l, int argc, char **argv)
+{
+	static uint16_t t[4000];
+	unsigned n = sizeof(t) / sizeof(t[0]);
+	unsigned best = 0;
+	int underruns;
+
+	//constant edge length, shortened until the stream runs empty
+	for(unsigned us = 2000; us >= 13; us = us * 3 / 4)
+	{
+		t[0] = 0;
+		for(unsigned i = 1; i < n; i++) t[i] = us;
+		underruns = stream(l, t, n);
+		if(underruns < 0) return 1;
+		printf("%5u us/edge (%6.0f edges/s): %s\n", us, 1e6 / us, underruns ? "underrun" : "ok");
+		if(underruns) break;
+		best = us;
+	}
+	if(best) printf("max. sustained rate: %.0f edges/s (%u us/edge)\n", 1e6 / best, best);
+	printf("%u retransmits, %u NAKs\n", l->retransmits, l->naks);
+	return 0;
+}
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+	stop = 1;
+}
+
+/* One line per burst (a space > 100 ms ends it): device time in seconds,
+ * then the intervals in us, marks positive, spaces negative.
+ */
+static int cmd_sniff(link_t *l, int argc, char **argv)
+{
+	double seconds = (argc > 1) ? atof(argv[1]) : 0;
+	double start = link_time();
+	uint8_t r[FRAME_MAX_PAYLOAD], consumed = 0;
+	unsigned long long now = 0, intervals = 0;
+	unsigned overruns = 0, lost = 0;
+	int n, line = 0;
+
+	signal(SIGINT, on_signal);
+	if(link_request(l, FRAME_SNIFF_START, 0, 0, 0) < 0)
+	{
+		fprintf(stderr, "sniff: cannot start\n");
+		return 1;
+	}
+	while(!stop && (seconds <= 0 || link_time() - start < seconds))
+	{
+		n = link_request(l, FRAME_SNIFF_READ, &consumed, 1, r);
+		consumed = 0;
+		if(n == 0) continue;		//answer to a retransmission, request again
+		if(n < 3)
+		{
+			fprintf(stderr, "sniff: error %d\n", n);
+			break;
+		}
+		if((unsigned)(r[0] | (r[1] << 8)) != overruns)
+		{
+			lost += (uint16_t)((r[0] | (r[1] << 8)) - overruns);
+			overruns = r[0] | (r[1] << 8);
+			fprintf(stderr, "sniff: %u intervals lost (ring full)\n", lost);
+		}
+		for(int i = 3, k = 0; k < r[2] && i < n; k++)
+		{
+			unsigned long long v = 0;
+			unsigned long us;
+
+			for(int shift = 0; i < n; shift += 7)
+			{
+				v |= (unsigned long long)(r[i] & 0x7F) << shift;
+				if(!(r[i++] & 0x80)) break;
+			}
+			us = (v >> 1) * SNIFF_TICK_US;
+			if(!line && (v & 1))
+			{
+				printf("%.6f", now / 1e6);
+				line = 1;
+			}
+			if(line) printf(" %c%lu", (v & 1) ? '+' : '-', us);
+			if(!(v & 1) && us > 100000 && line)
+			{
+				printf("\n");
+				fflush(stdout);
+				line = 0;
+			}
+			now += us;
+			intervals++;
+		}
+		consumed = r[2];
+		if(r[2] == 0) usleep(1000);
+	}
+	if(line) printf("\n");
+	if(consumed) link_request(l, FRAME_SNIFF_READ, &consumed, 1, r);
+	link_request(l, FRAME_SNIFF_STOP, 0, 0, 0);
+	fprintf(stderr, "%llu intervals, %u lost, %u retransmits, %u NAKs\n", intervals, lost, l->retransmits, l->naks);
+	return 0;
+}
+
+static int event_seq = -1;
+static unsigned events_lost;
+
+//one line per key: device time, protocol, address, command, repeat, hold
+static void on_key(uint8_t seq, const uint8_t *p, int len)
+{
+	unsigned long stamp;
+
+	if(len != IRDEC_EVENT_SIZE) return;
+	if(event_seq >= 0 && seq != (uint8_t)(event_seq + 1))
+	{
+		events_lost += (uint8_t)(seq - event_seq - 1);
+		fprintf(stderr, "events: %u lost\n", events_lost);
+	}
+	event_seq = seq;
+	stamp = p[6] | (p[7] << 8) | (p[8] << 16) | ((unsigned long)p[9] << 24);
+	printf("%.6f %s 0x%04X 0x%02X %s %u\n", stamp * SNIFF_TICK_US / 1e6,
+		(p[0] == IRDEC_NEC) ? "nec" : "necx", p[1] | (p[2] << 8), p[3],
+		(p[4] & IRDEC_REPEAT) ? "repeat" : "key", p[5]);
+	fflush(stdout);
+}
+
+static int cmd_events(link_t *l, int argc, char **argv)
+{
+	double seconds = (argc > 1) ? atof(argv[1]) : 0;
+	double start = link_time();
+	uint8_t mode = SNIFF_EVENTS;
+
+	signal(SIGINT, on_signal);
+	l->on_event = on_key;
+	if(link_request(l, FRAME_SNIFF_START, &mode, 1, 0) < 0)
+	{
+		fprintf(stderr, "events: cannot start\n");
+		return 1;
+	}
+	while(!stop && (seconds <= 0 || link_time() - start < seconds)) link_poll(l, 100);
+	link_request(l, FRAME_SNIFF_STOP, 0, 0, 0);
+	return 0;
+}
+
+static const struct
+{
+	const char *name;
+	int (*run)(link_t *l, int argc, char **argv);
+} commands[] =
+{
+	{ "info", cmd_info },
+	{ "ping", cmd_ping },
+	{ "bench", cmd_bench },
+	{ "export", cmd_export },
+	{ "import", cmd_import },
+	{ "stream", cmd_stream },
+	{ "stream-bench", cmd_stream_bench },
+	{ "sniff", cmd_sniff },
+	{ "events", cmd_events },
+};
+
+int main(int argc, char **argv)
+{
+	const char *port = "/dev/ttyACM0";
+	unsigned baud = 1000000;
+	link_t link;
+	int opt, ret;
+
+	while(argc > 2 && argv[1][0] == '-')
+	{
+		opt = argv[1][1];
+		if(opt == 'p') port = argv[2];
+		else if(opt == 'b') baud = strtoul(argv[2], NULL, 0);
+		else break;
+		argv += 2;
+		argc -= 2;
+	}
+	for(size_t i = 0; argc > 1 && i < sizeof(commands) / sizeof(commands[0]); i++)
+	{
+		if(strcmp(argv[1], commands[i].name)) continue;
+		if(link_open(&link, port, baud)) return 1;
+		ret = commands[i].run(&link, argc - 1, argv + 1);
+		link_close(&link);
+		return ret;
+	}
+	fprintf(stderr, "usage: %s [-p port] [-b baud] <command> [args]\n"
+		"  info | ping | bench [seconds] | export <file> | import <file>\n"
+		"  stream <file> | stream-bench | sniff [seconds]\n"
+		"  events [seconds]\n", argv[0]);
+	return 2;
+}
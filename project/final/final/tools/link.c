@@ -0,0 +1,184 @@
+/*
+ * link.c
+ *
+ * Host side of the binary protocol (see link.h).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "link.h"
+
+/// time for the Arduino bootloader after the reset by opening the port
+#define LINK_OPEN_TIMEOUT 3.0
+
+static speed_t baud_speed(unsigned baud)
+{
+	switch(baud)
+	{
+		case 9600: return B9600;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		case 230400: return B230400;
+#ifdef B500000
+		case 500000: return B500000;
+		case 1000000: return B1000000;
+		case 2000000: return B2000000;
+#endif
+		default: return 0;
+	}
+}
+
+double link_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//read one frame (up to the 0x00 delimiter), returns its length, 0 on timeout
+static int read_frame(link_t *l, uint8_t *buf, int timeout_ms)
+{
+	double end = link_time() + timeout_ms / 1000.0;
+	int len = 0;
+
+	for(;;)
+	{
+		struct pollfd pfd = { l->fd, POLLIN, 0 };
+		int left = (int)((end - link_time()) * 1000);
+		uint8_t c;
+
+		if(left < 0 || poll(&pfd, 1, left) <= 0) return 0;
+		if(read(l->fd, &c, 1) != 1) return 0;
+		if(c == 0)
+		{
+			if(len > 0 && len <= FRAME_MAX_ENCODED) return len;
+			len = 0;	//empty frame, text output or garbage before it
+			continue;
+		}
+		if(len <= FRAME_MAX_ENCODED) buf[len] = c;
+		len++;
+	}
+}
+
+//frame without request? -> on_event
+static int event(link_t *l, uint8_t *in, int plen)
+{
+	if(plen < 0 || in[0] != FRAME_EVENT) return 0;
+	if(l->on_event) l->on_event(in[1], &in[2], plen);
+	return 1;
+}
+
+int link_poll(link_t *l, int timeout_ms)
+{
+	uint8_t in[FRAME_MAX_ENCODED + 1];
+	double end = link_time() + timeout_ms / 1000.0;
+	int events = 0;
+	int left, rlen;
+
+	while((left = (int)((end - link_time()) * 1000)) > 0)
+	{
+		rlen = read_frame(l, in, left);
+		if(rlen == 0) break;
+		events += event(l, in, frame_unpack(in, rlen));
+	}
+	return events;
+}
+
+int link_request(link_t *l, uint8_t type, const void *payload, uint8_t len, uint8_t *reply)
+{
+	uint8_t out[FRAME_MAX_ENCODED + 1];
+	uint8_t in[FRAME_MAX_ENCODED + 1];
+	int n = frame_pack(type, l->seq, payload, len, out);
+
+	for(int try = 0; try < l->tries; try++)
+	{
+		double end = link_time() + l->timeout_ms / 1000.0;
+
+		if(try) l->retransmits++;
+		if(write(l->fd, out, n) != n) return LINK_ERR_IO;
+		for(;;)
+		{
+			int left = (int)((end - link_time()) * 1000);
+			int rlen = (left > 0) ? read_frame(l, in, left) : 0;
+			int plen;
+
+			if(rlen == 0) break;			//timeout -> send again
+			plen = frame_unpack(in, rlen);
+			if(event(l, in, plen)) continue;
+			if(plen < 0 || in[1] != l->seq) continue;	//broken or old answer
+			if(in[0] == FRAME_NAK)
+			{
+				l->naks++;
+				if(plen >= 1 && in[2] == FRAME_NAK_CRC) break;
+				l->seq++;
+				return -(plen >= 1 ? in[2] : FRAME_NAK_STATE);
+			}
+			if(in[0] != FRAME_ACK) continue;
+			if(reply) memcpy(reply, &in[2], plen);
+			l->seq++;
+			return plen;
+		}
+	}
+	return LINK_ERR_TIMEOUT;
+}
+
+int link_open(link_t *l, const char *port, unsigned baud)
+{
+	struct termios tio;
+	speed_t speed = baud_speed(baud);
+	double end;
+	uint8_t zero = 0;
+
+	memset(l, 0, sizeof(*l));
+	l->timeout_ms = 100;
+	l->tries = 5;
+	if(!speed)
+	{
+		fprintf(stderr, "%u: unsupported baudrate\n", baud);
+		return LINK_ERR_IO;
+	}
+	l->fd = open(port, O_RDWR | O_NOCTTY);
+	if(l->fd < 0 || tcgetattr(l->fd, &tio))
+	{
+		perror(port);
+		return LINK_ERR_IO;
+	}
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+	tio.c_cflag |= CLOCAL | CREAD;
+	if(tcsetattr(l->fd, TCSANOW, &tio))
+	{
+		perror(port);
+		return LINK_ERR_IO;
+	}
+
+	//0x00 switches the device to binary frames, ping until it answers
+	end = link_time() + LINK_OPEN_TIMEOUT;
+	l->tries = 1;
+	while(link_time() < end)
+	{
+		tcflush(l->fd, TCIFLUSH);
+		if(write(l->fd, &zero, 1) != 1) return LINK_ERR_IO;
+		if(link_request(l, FRAME_PING, 0, 0, 0) >= 0)
+		{
+			l->tries = 5;
+			l->retransmits = 0;
+			return 0;
+		}
+	}
+	fprintf(stderr, "%s: device does not answer\n", port);
+	return LINK_ERR_TIMEOUT;
+}
+
+void link_close(link_t *l)
+{
+	link_request(l, FRAME_CLOSE, 0, 0, 0);
+	close(l->fd);
+}
@@ -0,0 +1,61 @@
+/*
+ * link.h
+ *
+ * Host side of the binary protocol (see proto.h, frame.h): serial port
+ * setup and stop-and-wait requests with retransmission.
+ */
+
+#ifndef _LINK_H_
+#define _LINK_H_
+
+#include <stdint.h>
+#include "../frame.h"
+
+/// no answer after all retries
+#define LINK_ERR_TIMEOUT -100
+/// serial port error
+#define LINK_ERR_IO -101
+
+typedef struct
+{
+	int fd;
+	uint8_t seq;			///< seq of the next request
+	int timeout_ms;			///< answer timeout of one try
+	int tries;				///< sends per request
+	unsigned retransmits;	///< statistics
+	unsigned naks;
+	/// called for every FRAME_EVENT (sent by the device without request), may be 0
+	void (*on_event)(uint8_t seq, const uint8_t *payload, int len);
+} link_t;
+
+/** @brief Open the serial port and start a binary session
+ *
+ * Waits for the device to answer (opening the port may reset an Arduino).
+ *
+ * @return 0 on success, LINK_ERR_* otherwise
+ */
+int link_open(link_t *l, const char *port, unsigned baud);
+
+/** @brief Send a request and wait for the answer
+ *
+ * The request is sent again on timeout or FRAME_NAK_CRC.
+ *
+ * @param reply (out) -> ACK payload (FRAME_MAX_PAYLOAD bytes), may be 0
+ * @return ACK payload size, -FRAME_NAK_* on NAK, LINK_ERR_* otherwise
+ */
+int link_request(link_t *l, uint8_t type, const void *payload, uint8_t len, uint8_t *reply);
+
+/** @brief Wait for frames without a request (FRAME_EVENT, see on_event)
+ *
+ * @param timeout_ms Time to wait
+ * @return number of events received
+ */
+int link_poll(link_t *l, int timeout_ms);
+
+/** @brief End the binary session (FRAME_CLOSE) and close the port */
+void link_close(link_t *l);
+
+/** @brief Monotonic time in seconds */
+double link_time(void);
+
+#endif /* _LINK_H_ */
@@ -0,0 +1,245 @@
+/*
+ * simboard.c
+ *
+ * Host tool: simavr board for the firmware. Runs the firmware in simavr
+ * with models of the external parts attached, so the storage backends
+ * can be tested without real chips (see make selftest):
+ *
+ *   - W25Qxx SPI NOR flash (1 MB), SPI bus, CS = PC0   (STORAGE=SPIFLASH)
+ *   - 24LC256 I2C EEPROM (32 KB), TWI, address 0x50    (STORAGE=I2C)
+ *
+ * The UART output of the firmware is printed by simavr. The simulation
+ * ends when the firmware sleeps with interrupts off (selftest_run()).
+ *
+ * usage: simboard <firmware.elf>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "avr_spi.h"
+#include "avr_ioport.h"
+#include "avr_twi.h"
+
+#define F_CPU 16000000
+
+////////////////////////////////////////////////////////////////////////
+/////////// W25Qxx SPI NOR flash model
+////////////////////////////////////////////////////////////////////////
+
+#define NOR_SIZE (1024 * 1024)
+#define NOR_PAGE 256
+#define NOR_SECTOR 4096
+
+static struct
+{
+	uint8_t mem[NOR_SIZE];
+	int selected;
+	uint8_t cmd;
+	unsigned count;		// bytes received since CS went low
+	uint32_t addr;
+	int wel;			// write enable latch
+	avr_irq_t *miso;
+	unsigned programs, erases;
+} nor;
+
+static void nor_cs(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	if(!value)
+	{
+		nor.selected = 1;
+		nor.count = 0;
+		return;
+	}
+	if(!nor.selected) return;
+	nor.selected = 0;
+
+	// program/erase are executed at CS high and clear the latch
+	if(nor.cmd == 0x20 && nor.count >= 4)
+	{
+		if(!nor.wel) fprintf(stderr, "simboard: sector erase without write enable\n");
+		else
+		{
+			memset(&nor.mem[nor.addr & ~(NOR_SECTOR - 1) & (NOR_SIZE - 1)], 0xFF, NOR_SECTOR);
+			nor.erases++;
+		}
+	}
+	if(nor.cmd == 0x02 || nor.cmd == 0x20) nor.wel = 0;
+}
+
+static void nor_byte(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	uint8_t in = value;
+	uint8_t out = 0xFF;
+
+	if(!nor.selected) return;		// transfer to the LCD
+
+	if(nor.count == 0)
+	{
+		nor.cmd = in;
+		nor.addr = 0;
+		if(in == 0x06) nor.wel = 1;
+		if(in == 0x04) nor.wel = 0;
+	}
+	else switch(nor.cmd)
+	{
+		case 0x05:			// read status: never busy, operations are instant
+			out = nor.wel ? 0x02 : 0x00;
+			break;
+		case 0x9F:			// JEDEC ID: Winbond W25Q80
+			out = (nor.count == 1) ? 0xEF : (nor.count == 2) ? 0x40 : 0x14;
+			break;
+		case 0x03:			// read
+		case 0x0B:			// fast read (one dummy byte)
+		case 0x02:			// page program
+		case 0x20:			// sector erase
+			if(nor.count <= 3)
+			{
+				nor.addr = (nor.addr << 8) | in;
+				break;
+			}
+			if(nor.cmd == 0x0B && nor.count == 4) break;
+			if(nor.cmd == 0x02)
+			{
+				// programming clears bits only, wraps within the page
+				if(!nor.wel) fprintf(stderr, "simboard: page program without write enable\n");
+				else nor.mem[nor.addr % NOR_SIZE] &= in;
+				if(nor.count == 4) nor.programs++;
+				nor.addr = (nor.addr & ~(NOR_PAGE - 1)) | ((nor.addr + 1) & (NOR_PAGE - 1));
+			}
+			else if(nor.cmd != 0x20)
+			{
+				out = nor.mem[nor.addr % NOR_SIZE];
+				nor.addr++;
+			}
+			break;
+	}
+	nor.count++;
+	avr_raise_irq(nor.miso, out);
+}
+
+static void nor_attach(avr_t *avr)
+{
+	memset(nor.mem, 0xFF, sizeof(nor.mem));
+	nor.miso = avr_io_getirq(avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_INPUT);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_OUTPUT), nor_byte, NULL);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 0), nor_cs, NULL);
+	nor.selected = 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+/////////// 24LC256 I2C EEPROM model
+////////////////////////////////////////////////////////////////////////
+
+#define EE_SIZE (32 * 1024)
+#define EE_PAGE 64
+#define EE_ADDRESS 0x50
+#define EE_WRITE_US 5000		// write cycle, the chip does not ACK meanwhile
+
+static struct
+{
+	uint8_t mem[EE_SIZE];
+	avr_t *avr;
+	int selected;
+	unsigned count;		// bytes written since the start condition
+	uint16_t addr;
+	int written;		// data bytes written -> write cycle at stop
+	avr_cycle_count_t busy_until;
+	avr_irq_t *in;
+	unsigned pages, polls;
+} ee;
+
+static void ee_msg(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	avr_twi_msg_irq_t v;
+
+	v.u.v = value;
+	if(v.u.twi.msg & TWI_COND_STOP)
+	{
+		if(ee.selected && ee.written)
+		{
+			ee.busy_until = ee.avr->cycle + avr_usec_to_cycles(ee.avr, EE_WRITE_US);
+			ee.pages++;
+		}
+		ee.selected = 0;
+		ee.written = 0;
+	}
+	if(v.u.twi.msg & TWI_COND_START)
+	{
+		ee.selected = 0;
+		ee.count = 0;
+		if((v.u.twi.addr >> 1) != EE_ADDRESS) return;
+		if(ee.avr->cycle < ee.busy_until)
+		{
+			ee.polls++;		// busy: no ACK
+			return;
+		}
+		ee.selected = 1;
+		avr_raise_irq(ee.in, avr_twi_irq_msg(TWI_COND_ACK, v.u.twi.addr, 1));
+	}
+	if(!ee.selected) return;
+	if(v.u.twi.msg & TWI_COND_WRITE)
+	{
+		avr_raise_irq(ee.in, avr_twi_irq_msg(TWI_COND_ACK, v.u.twi.addr, 1));
+		if(ee.count < 2) ee.addr = ((ee.addr << 8) | v.u.twi.data) & (EE_SIZE - 1);
+		else
+		{
+			// page write, the address wraps within the page
+			ee.mem[ee.addr] = v.u.twi.data;
+			ee.addr = (ee.addr & ~(EE_PAGE - 1)) | ((ee.addr + 1) & (EE_PAGE - 1));
+			ee.written = 1;
+		}
+		ee.count++;
+	}
+	if(v.u.twi.msg & TWI_COND_READ)
+	{
+		// sequential read, the address wraps at the end of the memory
+		avr_raise_irq(ee.in, avr_twi_irq_msg(TWI_COND_READ, v.u.twi.addr, ee.mem[ee.addr]));
+		ee.addr = (ee.addr + 1) & (EE_SIZE - 1);
+	}
+}
+
+static void ee_attach(avr_t *avr)
+{
+	memset(ee.mem, 0xFF, sizeof(ee.mem));
+	ee.avr = avr;
+	ee.in = avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT), ee_msg, NULL);
+}
+
+////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	elf_firmware_t firmware;
+	avr_t *avr;
+	int state = cpu_Running;
+
+	if(argc != 2)
+	{
+		fprintf(stderr, "usage: %s <firmware.elf>\n", argv[0]);
+		return 2;
+	}
+	memset(&firmware, 0, sizeof(firmware));
+	if(elf_read_firmware(argv[1], &firmware))
+	{
+		fprintf(stderr, "%s: cannot read firmware\n", argv[1]);
+		return 1;
+	}
+	avr = avr_make_mcu_by_name("atmega328p");
+	if(!avr) return 1;
+	avr_init(avr);
+	avr_load_firmware(avr, &firmware);
+	if(!avr->frequency) avr->frequency = F_CPU;
+
+	nor_attach(avr);
+	ee_attach(avr);
+
+	while((state != cpu_Done) && (state != cpu_Crashed)) state = avr_run(avr);
+
+	fprintf(stderr, "simboard: nor flash %u page programs, %u sector erases\n", nor.programs, nor.erases);
+	fprintf(stderr, "simboard: i2c eeprom %u page writes, %u busy polls\n", ee.pages, ee.polls);
+	return (state == cpu_Crashed) ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * twi.c
+ *
+ * This module is responsible for the I2C (TWI) interface (see twi.h).
+ */
+
+#include "common.h"
+#include <util/twi.h>
+
+#define TWCR_NEXT ((1<<TWINT) | (1<<TWEN) | (1<<TWIE))		///< continue
+#define TWCR_START (TWCR_NEXT | (1<<TWSTA))					///< (repeated) start condition
+#define TWCR_STOP ((1<<TWINT) | (1<<TWEN) | (1<<TWSTO))		///< stop condition, ends the transfer
+#define TWCR_ACK (TWCR_NEXT | (1<<TWEA))					///< receive, acknowledge
+
+static volatile uint8_t twi_state = TWI_OK;
+static uint8_t twi_sla;
+static const uint8_t *twi_header;
+static uint8_t twi_hlen;
+static uint8_t *twi_data;
+static uint16_t twi_len;
+static uint8_t twi_dir;
+static uint8_t twi_reading;	///< SLA+R is sent on the next start
+
+void twi_init()
+{
+	PORTC |= (1 << PC4) | (1 << PC5);		//internal pullups (external ones recommended)
+	TWSR = 0;								//prescaler 1
+	TWBR = ((F_CPU / TWI_SCL_HZ) - 16) / 2;
+	TWCR = (1<<TWEN);
+}
+
+uint8_t twi_start(uint8_t address, const uint8_t *header, uint8_t hlen,
+	uint8_t *data, uint16_t len, uint8_t dir)
+{
+	if(twi_state == TWI_BUSY) return TWI_BUSY;
+	twi_sla = address << 1;
+	twi_header = header;
+	twi_hlen = hlen;
+	twi_data = data;
+	twi_len = len;
+	twi_dir = dir;
+	//a read without header starts with SLA+R right away
+	twi_reading = (dir == TWI_READ_DATA) && (hlen == 0);
+	twi_state = TWI_BUSY;
+	TWCR = TWCR_START;
+	return TWI_OK;
+}
+
+uint8_t twi_status()
+{
+	return twi_state;
+}
+
+uint8_t twi_wait()
+{
+	while(twi_state == TWI_BUSY);
+	//the stop condition is still being sent
+	while(TWCR & (1<<TWSTO));
+	return twi_state;
+}
+
+static void twi_end(uint8_t state)
+{
+	TWCR = TWCR_STOP;
+	twi_state = state;
+}
+
+ISR(TWI_vect)
+{
+	switch(TW_STATUS)
+	{
+		case TW_START:
+		case TW_REP_START:
+			TWDR = twi_sla | (twi_reading ? TW_READ : TW_WRITE);
+			TWCR = TWCR_NEXT;
+			break;
+
+		case TW_MT_SLA_ACK:
+		case TW_MT_DATA_ACK:
+			if(twi_hlen)
+			{
+				TWDR = *twi_header++;
+				twi_hlen--;
+				TWCR = TWCR_NEXT;
+			}
+			else if(twi_dir == TWI_READ_DATA)
+			{
+				twi_reading = 1;
+				TWCR = TWCR_START;
+			}
+			else if(twi_len)
+			{
+				TWDR = *twi_data++;
+				twi_len--;
+				TWCR = TWCR_NEXT;
+			}
+			else twi_end(TWI_OK);
+			break;
+
+		case TW_MR_SLA_ACK:
+			if(twi_len == 0) twi_end(TWI_OK);
+			else TWCR = (twi_len > 1) ? TWCR_ACK : TWCR_NEXT;	//NACK the last byte
+			break;
+
+		case TW_MR_DATA_ACK:
+			*twi_data++ = TWDR;
+			twi_len--;
+			TWCR = (twi_len > 1) ? TWCR_ACK : TWCR_NEXT;
+			break;
+
+		case TW_MR_DATA_NACK:
+			*twi_data++ = TWDR;
+			twi_len--;
+			twi_end(TWI_OK);
+			break;
+
+		case TW_MT_SLA_NACK:
+		case TW_MT_DATA_NACK:
+		case TW_MR_SLA_NACK:
+			twi_end(TWI_ERR_NACK);
+			break;
+
+		case TW_MT_ARB_LOST:
+		default:
+			twi_end(TWI_ERR_BUS);
+			break;
+	}
+}
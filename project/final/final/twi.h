@@ -0,0 +1,62 @@
+/*
+ * twi.h
+ *
+ * This module is responsible for the I2C (TWI) interface (master only).
+ *
+ * A transfer is started with twi_start() and runs in the TWI interrupt,
+ * the caller can do something else meanwhile and check twi_status() or
+ * wait with twi_wait(). Only one transfer can run at once.
+ *
+ * A transfer writes a header (e.g. a memory address) and then either
+ * writes the data or reads it after a repeated start.
+ */
+
+#ifndef _TWI_H_
+#define _TWI_H_
+
+/** @brief I2C clock */
+#define TWI_SCL_HZ 400000UL
+
+/** @brief Status of a transfer */
+#define TWI_OK 0
+#define TWI_ERR_NACK 1		///< slave did not acknowledge its address or data
+#define TWI_ERR_BUS 2		///< bus error or arbitration lost
+#define TWI_BUSY 0xFF		///< transfer in progress
+
+/** @brief Direction of the data part of a transfer */
+#define TWI_WRITE_DATA 0
+#define TWI_READ_DATA 1
+
+/** @brief Init the TWI interface (SDA = PC4, SCL = PC5, TWI_SCL_HZ) */
+void twi_init();
+
+/** @brief Start a transfer (returns immediately)
+ *
+ * The buffers must stay valid until the transfer is finished.
+ * A transfer without header and data only addresses the slave
+ * (ACK polling).
+ *
+ * @param address 7 bit slave address
+ * @param header Bytes written first (may be 0 if hlen is 0)
+ * @param hlen Number of header bytes
+ * @param data Data to write or buffer for the read data
+ * @param len Number of data bytes
+ * @param dir TWI_WRITE_DATA or TWI_READ_DATA
+ * @return TWI_OK if started, TWI_BUSY if another transfer is running
+ */
+uint8_t twi_start(uint8_t address, const uint8_t *header, uint8_t hlen,
+	uint8_t *data, uint16_t len, uint8_t dir);
+
+/** @brief Status of the last transfer
+ *
+ * @return TWI_BUSY while running, TWI_OK or TWI_ERR_* when finished
+ */
+uint8_t twi_status();
+
+/** @brief Wait for the end of the transfer
+ *
+ * @return TWI_OK or TWI_ERR_*
+ */
+uint8_t twi_wait();
+
+#endif /* _TWI_H_ */
@@ -0,0 +1,143 @@
+/*
+ * xfer.c
+ *
+ * This module is responsible for the library import/export (see xfer.h).
+ * The functions are request handlers of proto.c (see proto_handler_t).
+ */
+
+#include "common.h"
+
+static uint16_t import_size = 0;		///< 0: no import running
+static uint32_t import_erased;			///< end of the discarded storage
+static uint8_t import_header[EEPROM_HEADER_SIZE];
+static uint8_t import_done = 0;			///< the last import is activated
+static uint16_t import_crc;				///< its CRC and command count,
+static uint8_t import_count;			///< for a repeated FRAME_IMPORT_END
+
+//CRC of the stored bytes [from, to)
+static uint16_t image_crc(uint16_t crc, uint16_t from, uint16_t to)
+{
+	uint8_t buf[32];
+
+	while(from < to)
+	{
+		uint8_t n = (to - from > sizeof(buf)) ? sizeof(buf) : to - from;
+		storage_read(from, buf, n);
+		crc = frame_crc16(crc, buf, n);
+		from += n;
+	}
+	return crc;
+}
+
+/** @brief FRAME_LIB_INFO: size, CRC and command count of the library image */
+uint8_t xfer_lib_info(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	uint16_t size = eeprom_get_image_size();
+	uint16_t crc = image_crc(0, 0, size);
+
+	reply[0] = size & 0xFF;
+	reply[1] = size >> 8;
+	reply[2] = crc & 0xFF;
+	reply[3] = crc >> 8;
+	reply[4] = eeprom_get_command_count();
+	*reply_len = 5;
+	return 0;
+}
+
+/** @brief FRAME_READ: read up to FRAME_MAX_PAYLOAD bytes of the storage */
+uint8_t xfer_read(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	uint16_t addr;
+
+	if(len != 3) return FRAME_NAK_LENGTH;
+	addr = payload[0] | (payload[1] << 8);
+	len = payload[2];
+	if((len > FRAME_MAX_PAYLOAD) || ((uint32_t)addr + len > STORAGE_SIZE)) return FRAME_NAK_LENGTH;
+	storage_read(addr, reply, len);
+	*reply_len = len;
+	return 0;
+}
+
+/** @brief FRAME_IMPORT_BEGIN: invalidate the library and prepare the storage */
+uint8_t xfer_import_begin(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	uint16_t size;
+
+	if(len != 2) return FRAME_NAK_LENGTH;
+	size = payload[0] | (payload[1] << 8);
+	if((size <= EEPROM_HEADER_SIZE) || (size > STORAGE_SIZE)) return FRAME_NAK_LENGTH;
+
+	//invalidate the library first: an interrupted import is formatted
+	//(discarded before, the SPI flash writes the header without a merge),
+	//the other units are discarded when the data reaches them
+	storage_discard(0, STORAGE_ERASE_SIZE);
+	import_erased = STORAGE_ERASE_SIZE;
+	memset(import_header, 0xFF, sizeof(import_header));
+	storage_write(0, import_header, sizeof(import_header));
+	storage_flush();
+	import_size = size;
+	import_done = 0;
+	return 0;
+}
+
+/** @brief FRAME_IMPORT_DATA: write a chunk of the image */
+uint8_t xfer_import_data(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	uint16_t addr;
+
+	if(import_size == 0) return FRAME_NAK_STATE;
+	if(len < 3) return FRAME_NAK_LENGTH;
+	addr = payload[0] | (payload[1] << 8);
+	payload += 2;
+	len -= 2;
+	if((uint32_t)addr + len > import_size) return FRAME_NAK_LENGTH;
+
+	//the header is written last (xfer_import_end())
+	while(len && (addr < EEPROM_HEADER_SIZE))
+	{
+		import_header[addr++] = *payload++;
+		len--;
+	}
+	if(!len) return 0;
+	//erase unit by unit, a request never blocks for the whole memory
+	while(import_erased < (uint32_t)addr + len)
+	{
+		storage_discard(import_erased, STORAGE_ERASE_SIZE);
+		import_erased += STORAGE_ERASE_SIZE;
+	}
+	storage_write(addr, payload, len);
+	return 0;
+}
+
+/** @brief FRAME_IMPORT_END: verify the image and activate the library
+ *
+ * A repeated request (the ACK was lost) gets the same reply again.
+ */
+uint8_t xfer_import_end(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len)
+{
+	uint16_t crc;
+
+	if(len != 2) return FRAME_NAK_LENGTH;
+	if(import_size == 0)
+	{
+		if(!import_done || (import_crc != (payload[0] | (payload[1] << 8)))) return FRAME_NAK_STATE;
+		reply[0] = import_count;
+		*reply_len = 1;
+		return 0;
+	}
+	storage_flush();
+	crc = frame_crc16(0, import_header, sizeof(import_header));
+	crc = image_crc(crc, EEPROM_HEADER_SIZE, import_size);
+	import_size = 0;
+	if(crc != (payload[0] | (payload[1] << 8))) return FRAME_NAK_CHECK;
+
+	storage_write(0, import_header, sizeof(import_header));
+	storage_flush();
+	if(eeprom_init() != EEPROM_OK) return FRAME_NAK_CHECK;
+	import_crc = crc;
+	import_count = eeprom_get_command_count();
+	import_done = 1;
+	reply[0] = import_count;
+	*reply_len = 1;
+	return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * xfer.h
+ *
+ * This module is responsible for the library import/export over the
+ * binary protocol (see proto.h), e.g. backup/restore or cloning a unit
+ * (tools/irlink export/import).
+ *
+ * The library is transferred as image: the bytes 0 ... eeprom_get_image_size()
+ * of the storage (see eeprom.h), in chunks of up to XFER_CHUNK bytes.
+ *
+ *   FRAME_LIB_INFO      -> ACK: image size (2B) | image crc (2B) | commands (1B)
+ *   FRAME_READ          addr (2B) | len (1B) -> ACK: data
+ *   FRAME_IMPORT_BEGIN  image size (2B)
+ *   FRAME_IMPORT_DATA   addr (2B) | data (max. XFER_CHUNK B)
+ *   FRAME_IMPORT_END    image crc (2B) -> ACK: commands (1B)
+ *
+ * (multi byte values little endian, crc: CRC-16/XMODEM of the image)
+ *
+ * The imported chunks are written to the storage as they arrive, the
+ * backend collects sequential writes into whole pages. The header of
+ * the image is kept back until FRAME_IMPORT_END has verified the CRC
+ * of the written image, an interrupted import leaves no valid library
+ * (it is formatted on the next start).
+ */
+
+#ifndef _XFER_H_
+#define _XFER_H_
+
+/** @brief Max number of data bytes of a FRAME_IMPORT_DATA request */
+#define XFER_CHUNK (FRAME_MAX_PAYLOAD - 2)
+
+/** @brief FRAME_LIB_INFO: size, CRC and command count of the library image */
+uint8_t xfer_lib_info(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len);
+
+/** @brief FRAME_READ: read up to FRAME_MAX_PAYLOAD bytes of the storage */
+uint8_t xfer_read(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len);
+
+/** @brief FRAME_IMPORT_BEGIN: invalidate the library and prepare the storage */
+uint8_t xfer_import_begin(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len);
+
+/** @brief FRAME_IMPORT_DATA: write a chunk of the image */
+uint8_t xfer_import_data(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len);
+
+/** @brief FRAME_IMPORT_END: verify the image and activate the library
+ *
+ * A repeated request (the ACK was lost) gets the same reply again.
+ */
+uint8_t xfer_import_end(const uint8_t *payload, uint8_t len, uint8_t *reply, uint8_t *reply_len);
+
+#endif /* _XFER_H_ */